@@ -0,0 +1,276 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "alias_gibbs.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <blaze/Math.h>
+
+using blaze::DynamicMatrix;
+using blaze::DynamicVector;
+using blaze::CompressedMatrix;
+
+// Vose's alias method; tbl.topics must already hold the topic of each weight
+//
+static void build_alias_table(alias_table & tbl, alias_tables & tables) {
+    std::vector<double> & weights = tables.weights;
+    std::vector<std::size_t> & small = tables.small;
+    std::vector<std::size_t> & large = tables.large;
+
+    const std::size_t n = weights.size();
+    tbl.prob.resize(n);
+    tbl.alias.resize(n);
+    tbl.weights.assign(std::begin(weights), std::end(weights));
+    tbl.mass = 0.0;
+
+    for(const double w : weights) {
+        tbl.mass += w;
+    }
+
+    if(n < 1 || tbl.mass <= 0.0) {
+        tbl.mass = 0.0;
+        return;
+    }
+
+    small.clear();
+    large.clear();
+
+    const double scale = static_cast<double>(n) / tbl.mass;
+    for(std::size_t i = 0; i < n; ++i) {
+        tbl.prob[i] = weights[i] * scale;
+        tbl.alias[i] = i;
+        if(tbl.prob[i] < 1.0) {
+            small.push_back(i);
+        }
+        else {
+            large.push_back(i);
+        }
+    }
+
+    while(small.size() > 0 && large.size() > 0) {
+        const std::size_t s = small.back();
+        small.pop_back();
+        const std::size_t l = large.back();
+        large.pop_back();
+
+        tbl.alias[s] = l;
+        tbl.prob[l] = (tbl.prob[l] + tbl.prob[s]) - 1.0;
+
+        if(tbl.prob[l] < 1.0) {
+            small.push_back(l);
+        }
+        else {
+            large.push_back(l);
+        }
+    }
+
+    // entries left over are full columns (up to rounding error)
+    //
+    for(const std::size_t l : large) {
+        tbl.prob[l] = 1.0;
+    }
+    for(const std::size_t s : small) {
+        tbl.prob[s] = 1.0;
+    }
+}
+
+// weight of topic t in a table built over increasing topics, 0 when the
+// table has no entry for t
+//
+static inline double alias_table_weight(alias_table const& tbl, const std::size_t t) {
+    const auto it = std::lower_bound(std::begin(tbl.topics), std::end(tbl.topics), t);
+    return (it != std::end(tbl.topics) && *it == t) ? tbl.weights[it - std::begin(tbl.topics)] : 0.0;
+}
+
+static inline std::size_t sample_alias_table(alias_table const& tbl, const double u) {
+    const std::size_t n = tbl.prob.size();
+    const double x = u * static_cast<double>(n);
+    const std::size_t i = std::min(static_cast<std::size_t>(x), n-1);
+    return (x - static_cast<double>(i)) < tbl.prob[i] ? tbl.topics[i] : tbl.topics[tbl.alias[i]];
+}
+
+void alias_gibbs(
+    sparse_count_matrix_t const& dwcm,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens, count_vector_t & ztot,
+    alias_tables & tables,
+    counter_rng & rng,
+    const std::size_t n_topics, const double N, const double alpha, const double beta,
+    const model_sharing sharing,
+    dirty_words * dirty) {
+
+    const std::size_t n_docs = dwcm.rows();
+    const std::size_t n_words = twcm.columns();
+    const double wbeta = N * beta;
+    const double kalpha = static_cast<double>(n_topics) * alpha;
+    const bool shared = (sharing == model_sharing::shared);
+
+    tables.words.resize(n_words);
+    tables.stamp.resize(n_words, 0);
+    ++tables.sweep;
+
+    // dense beta / (ztot[t] + wbeta) part of the word proposal
+    //
+    {
+        tables.weights.resize(n_topics);
+        tables.scale.resize(n_topics);
+        tables.smoothing.topics.resize(n_topics);
+        for(std::size_t t = 0; t < n_topics; ++t) {
+            tables.scale[t] = 1.0 / (ztot[t] + wbeta);
+            tables.weights[t] = beta * tables.scale[t];
+            tables.smoothing.topics[t] = t;
+        }
+        build_alias_table(tables.smoothing, tables);
+    }
+
+    // count of topic t for word w; with a shared twcm other threads add
+    // to it while it is read, so the load is atomic (load_count)
+    //
+    const auto word_count = [&twcm, shared](const std::size_t t, const std::size_t w) {
+        return shared ? load_count(twcm(t, w)) : twcm(t, w);
+    };
+
+    std::size_t pos = 0;
+
+    for(std::size_t d = 0; d < n_docs; ++d) {
+        const auto dwcm_end = dwcm.end(d);
+
+        // tokens of a document are stored contiguously; the doc proposal
+        // draws the topic of a random token in [doc_pos, doc_pos + n_d)
+        //
+        const std::size_t doc_pos = pos;
+        double n_d = 0.0;
+        for(sparse_count_matrix_t::ConstIterator it = dwcm.begin(d); it != dwcm_end; ++it) {
+            n_d += static_cast<double>(it->value());
+        }
+        const std::size_t doc_len = static_cast<std::size_t>(n_d);
+
+        rng.prefetch(doc_pos, doc_len);
+
+        for(sparse_count_matrix_t::ConstIterator it = dwcm.begin(d); it != dwcm_end; ++it) {
+            const std::size_t w = it->index();
+            const std::size_t k_max = static_cast<std::size_t>(it->value());
+
+            alias_table & wtbl = tables.words[w];
+            if(tables.stamp[w] != tables.sweep) {
+                tables.weights.clear();
+                wtbl.topics.clear();
+                for(std::size_t t = 0; t < n_topics; ++t) {
+                    const double ntw = word_count(t, w);
+                    if(ntw > 0) {
+                        tables.weights.push_back(ntw * tables.scale[t]);
+                        wtbl.topics.push_back(t);
+                    }
+                }
+                build_alias_table(wtbl, tables);
+                tables.stamp[w] = tables.sweep;
+            }
+
+            const double proposal_mass = wtbl.mass + tables.smoothing.mass;
+
+            for(std::size_t k = 0; k < k_max; k++) {
+                const std::size_t t0 = tokens.get(pos);
+                rng.seek(pos);
+
+                ztot[t0] -= 1;
+                add_count(twcm(t0, w), -1, shared);
+                tdcm(t0, d) -= 1;
+
+                // target distribution with the token removed
+                //
+                const auto target = [&](const std::size_t t) {
+                    return ((tdcm(t, d) + alpha) * (word_count(t, w) + beta)) / (ztot[t] + wbeta);
+                };
+
+                // the word proposal is read from the weights the word's
+                // table and the smoothing table were built with. both
+                // count the token at t0; without it t0 weighs
+                // (n - 1 + beta) / (ztot + wbeta - 1) where n and
+                // ztot + wbeta are recovered from the weights
+                //
+                const double q_t0 = alias_table_weight(wtbl, t0) + tables.smoothing.weights[t0];
+                const double denom_t0 = 1.0 / tables.scale[t0];
+                const double n_t0 = alias_table_weight(wtbl, t0) * denom_t0;
+                const double h_t0 = (n_t0 >= 0.5 && denom_t0 > 1.0) ?
+                    std::min((n_t0 - 1.0 + beta) / (denom_t0 - 1.0), q_t0) : q_t0;
+
+                const auto word_proposal = [&](const std::size_t t) {
+                    return (t == t0) ? h_t0 : alias_table_weight(wtbl, t) + tables.smoothing.weights[t];
+                };
+
+                // the doc proposal draws from the document's other tokens
+                //
+                const auto doc_proposal = [&](const std::size_t t) {
+                    return tdcm(t, d) + alpha;
+                };
+
+                std::size_t t = t0;
+                double pt = target(t);
+
+                for(std::size_t step = 0; step < tables.mh_steps; ++step) {
+                    // word proposal
+                    //
+                    {
+                        std::size_t s = t0;
+                        do {
+                            s = ((rng() * proposal_mass) < wtbl.mass) ?
+                                sample_alias_table(wtbl, rng()) :
+                                sample_alias_table(tables.smoothing, rng());
+                        } while(s == t0 && (rng() * q_t0) >= h_t0);
+
+                        if(s != t) {
+                            const double ps = target(s);
+                            const double accept = (ps * word_proposal(t)) / (pt * word_proposal(s));
+                            if(rng() < accept) {
+                                t = s;
+                                pt = ps;
+                            }
+                        }
+                    }
+
+                    // doc proposal
+                    //
+                    {
+                        const double n_other = n_d - 1.0;
+                        const double u = rng() * (n_other + kalpha);
+                        std::size_t s = 0;
+                        if(u < n_other) {
+                            const std::size_t j = std::min(static_cast<std::size_t>(u), doc_len-2);
+                            s = tokens.get(doc_pos + ((j < (pos - doc_pos)) ? j : j+1));
+                        }
+                        else {
+                            s = std::min(static_cast<std::size_t>((u - n_other) / alpha), n_topics-1);
+                        }
+
+                        if(s != t) {
+                            const double ps = target(s);
+                            const double accept = (ps * doc_proposal(t)) / (pt * doc_proposal(s));
+                            if(rng() < accept) {
+                                t = s;
+                                pt = ps;
+                            }
+                        }
+                    }
+                }
+
+                if(dirty != nullptr && t != t0) {
+                    dirty->mark(w);
+                }
+
+                tokens.set(pos, t);
+                ztot[t] += 1;
+                add_count(twcm(t, w), 1, shared);
+                tdcm(t, d) += 1;
+                ++pos;
+            }
+        }
+    }
+}
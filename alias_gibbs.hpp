@@ -0,0 +1,89 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __ALIAS_GIBBS_HPP__
+#define __ALIAS_GIBBS_HPP__
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+#include <blaze/Math.h>
+
+#include "gibbs.hpp"
+#include "counter_rng.hpp"
+#include "token_topics.hpp"
+#include "counts.hpp"
+
+using blaze::DynamicMatrix;
+using blaze::DynamicVector;
+using blaze::CompressedMatrix;
+
+// Metropolis-Hastings sampler in the style of LightLDA (Yuan, et al 2015)
+//
+// each token alternates a word-proposal step, drawn in O(1) from a
+// per-word alias table, and a doc-proposal step, drawn in O(1) from the
+// topic assignments of the document's tokens. the word proposal
+//
+//   q_w(t) = (twcm(t,w) + beta) / (ztot[t] + wbeta)
+//
+// is split into a sparse per-word table over the word's non-zero topics
+// and one dense table over beta / (ztot[t] + wbeta) shared by all words.
+// both tables divide by ztot as it was when the sweep started; word
+// tables are built lazily the first time a word is visited in a sweep,
+// from the thread's twcm at that moment, and are not updated as tokens
+// move. the acceptance test reads q from the weights the tables were
+// built with, so it matches the distribution proposals are actually drawn
+// from. the tables count the sampled token at its current topic, so that
+// entry is thinned by rejection to its weight without the token, and the
+// doc proposal skips the token itself; neither proposal depends on the
+// token's own topic. what remains approximate, as in LightLDA, is that the
+// tables see the other tokens as they were when the tables were built
+//
+struct alias_table {
+    std::vector<double> prob;
+    std::vector<std::size_t> alias;
+    // topic of each table entry, in increasing order
+    std::vector<std::size_t> topics;
+    // unnormalized weight of each entry when the table was built
+    std::vector<double> weights;
+    double mass;
+
+    alias_table() : prob(), alias(), topics(), weights(), mass(0.0) {}
+};
+
+struct alias_tables {
+    std::vector<alias_table> words;
+    // sweep each word table was last built in
+    std::vector<std::size_t> stamp;
+    alias_table smoothing;
+    // 1 / (ztot[t] + wbeta) when the sweep started
+    std::vector<double> scale;
+    std::size_t sweep;
+    // number of word/doc proposal pairs per token
+    std::size_t mh_steps;
+
+    // scratch space for table construction
+    std::vector<double> weights;
+    std::vector<std::size_t> small;
+    std::vector<std::size_t> large;
+
+    alias_tables() : words(), stamp(), smoothing(), scale(), sweep(0), mh_steps(2), weights(), small(), large() {}
+};
+
+void alias_gibbs(
+    sparse_count_matrix_t const& dwcm,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens, count_vector_t & ztot,
+    alias_tables & tables,
+    counter_rng & rng,
+    const std::size_t n_topics, const double N, const double alpha, const double beta,
+    const model_sharing sharing = model_sharing::replicated,
+    dirty_words * dirty = nullptr);
+
+#endif
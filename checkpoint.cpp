@@ -0,0 +1,249 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "checkpoint.hpp"
+
+// file layout, integers as native 64 bit words:
+//
+// magic, version, iterations, seed, n_topics, n_documents, sync_period, n_shards,
+// then per shard n_tokens, n_words and the shard's packed words
+//
+static const char checkpoint_magic[8] = { 'M', 'N', 'T', 'R', 'C', 'K', 'P', 'T' };
+static const std::uint64_t checkpoint_version = 1;
+
+static inline void put_u64(std::ofstream & ostrm, const std::uint64_t v) {
+    ostrm.write(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+static inline bool get_u64(std::ifstream & istrm, std::uint64_t & v) {
+    return static_cast<bool>(istrm.read(reinterpret_cast<char *>(&v), sizeof(v)));
+}
+
+bool read_checkpoint(std::string const& path, training_checkpoint & checkpoint) {
+    std::ifstream istrm(path, std::ios::in | std::ios::binary);
+    if(!istrm.is_open()) {
+        return false;
+    }
+
+    char magic[sizeof(checkpoint_magic)];
+    if(!istrm.read(magic, sizeof(magic)) || std::memcmp(magic, checkpoint_magic, sizeof(magic)) != 0) {
+        return false;
+    }
+
+    std::uint64_t version = 0, n_shards = 0;
+    if(!get_u64(istrm, version) || version != checkpoint_version ||
+       !get_u64(istrm, checkpoint.iterations) || !get_u64(istrm, checkpoint.seed) ||
+       !get_u64(istrm, checkpoint.n_topics) || !get_u64(istrm, checkpoint.n_documents) ||
+       !get_u64(istrm, checkpoint.sync_period) || !get_u64(istrm, n_shards)) {
+        return false;
+    }
+
+    checkpoint.shards.assign(n_shards, token_topics{});
+    for(token_topics & shard : checkpoint.shards) {
+        std::uint64_t n_tokens = 0, n_words = 0;
+        if(!get_u64(istrm, n_tokens) || !get_u64(istrm, n_words)) {
+            return false;
+        }
+
+        shard.resize(n_tokens, checkpoint.n_topics);
+        if(n_words != shard.words.size() ||
+           !istrm.read(reinterpret_cast<char *>(shard.words.data()), n_words * sizeof(std::uint64_t))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool write_checkpoint(std::string const& path, training_checkpoint const& checkpoint) {
+    const std::string tmp_path = path + ".tmp";
+
+    {
+        std::ofstream ostrm(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!ostrm.is_open()) {
+            return false;
+        }
+
+        ostrm.write(checkpoint_magic, sizeof(checkpoint_magic));
+        put_u64(ostrm, checkpoint_version);
+        put_u64(ostrm, checkpoint.iterations);
+        put_u64(ostrm, checkpoint.seed);
+        put_u64(ostrm, checkpoint.n_topics);
+        put_u64(ostrm, checkpoint.n_documents);
+        put_u64(ostrm, checkpoint.sync_period);
+        put_u64(ostrm, checkpoint.shards.size());
+
+        for(token_topics const& shard : checkpoint.shards) {
+            put_u64(ostrm, shard.size());
+            put_u64(ostrm, shard.words.size());
+            ostrm.write(reinterpret_cast<const char *>(shard.words.data()), shard.words.size() * sizeof(std::uint64_t));
+        }
+
+        ostrm.flush();
+        if(!ostrm) {
+            return false;
+        }
+    }
+
+    // the checkpoint being replaced stays readable until the new one is
+    // in place
+    //
+    const std::string prev_path = path + ".prev";
+    std::ifstream current(path, std::ios::in | std::ios::binary);
+    if(current.is_open()) {
+        current.close();
+        if(std::rename(path.c_str(), prev_path.c_str()) != 0) {
+            return false;
+        }
+    }
+
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+bool read_latest_checkpoint(std::string const& path, training_checkpoint & checkpoint) {
+    training_checkpoint prev;
+    const bool have_prev = read_checkpoint(path + ".prev", prev);
+
+    if(read_checkpoint(path, checkpoint)) {
+        if(!have_prev || checkpoint.iterations >= prev.iterations) {
+            return true;
+        }
+    }
+
+    if(have_prev) {
+        checkpoint = std::move(prev);
+    }
+
+    return have_prev;
+}
+
+bool restore_checkpoint(training_checkpoint const& checkpoint, const std::size_t n_topics, const std::size_t n_documents,
+                   std::vector<std::size_t> const& thread_idx, std::vector< token_topics > & tokens) {
+
+    std::size_t checkpoint_tokens = 0, shard_tokens = 0;
+    for(token_topics const& shard : checkpoint.shards) {
+        checkpoint_tokens += shard.size();
+    }
+    for(const std::size_t ti : thread_idx) {
+        shard_tokens += tokens[ti].size();
+    }
+
+    if(checkpoint.n_topics != n_topics || checkpoint.n_documents != n_documents || checkpoint_tokens != shard_tokens) {
+        return false;
+    }
+
+    // tokens of all shards in order on both sides; c and p walk the
+    // checkpoint's shards
+    //
+    std::size_t c = 0, p = 0;
+    for(const std::size_t ti : thread_idx) {
+        if(!tokens[ti].holds(n_topics)) {
+            tokens[ti].resize(tokens[ti].size(), n_topics);
+        }
+
+        const std::size_t n_tokens = tokens[ti].size();
+        for(std::size_t pos = 0; pos < n_tokens; ++pos) {
+            while(p == checkpoint.shards[c].size()) {
+                ++c;
+                p = 0;
+            }
+            tokens[ti].set(pos, checkpoint.shards[c].get(p++));
+        }
+    }
+
+    return true;
+}
+
+bool restore_checkpoint(training_checkpoint const& checkpoint, const std::size_t n_topics, const std::size_t n_documents, token_topics & tokens) {
+    std::vector< token_topics > shards(1);
+    std::swap(shards[0], tokens);
+
+    const bool restored = restore_checkpoint(checkpoint, n_topics, n_documents, std::vector<std::size_t>{0}, shards);
+    std::swap(shards[0], tokens);
+    return restored;
+}
+
+checkpoint_writer::checkpoint_writer(checkpoint_config const& config, const std::uint64_t rng_seed, const std::size_t topics, const std::size_t documents)
+    : path(config.path), every(config.every), seed(rng_seed), n_topics(topics), n_documents(documents), writing() {
+}
+
+checkpoint_writer::~checkpoint_writer() {
+    wait();
+}
+
+bool checkpoint_writer::due(const std::size_t i, const std::size_t iterations) const {
+    if(path.empty()) {
+        return false;
+    }
+
+    return (i + 1 == iterations) || (every > 0 && ((i + 1) % every) == 0);
+}
+
+void checkpoint_writer::iteration_done(const std::size_t i, const std::size_t iterations, std::vector<std::size_t> const& thread_idx, std::vector< token_topics > const& tokens) {
+    if(!due(i, iterations)) {
+        return;
+    }
+
+    save(i, thread_idx, tokens);
+}
+
+void checkpoint_writer::save(const std::size_t i, std::vector<std::size_t> const& thread_idx, std::vector< token_topics > const& tokens, const std::size_t sync_period) {
+    if(path.empty()) {
+        return;
+    }
+
+    training_checkpoint checkpoint;
+    checkpoint.iterations = i + 1;
+    checkpoint.seed = seed;
+    checkpoint.n_topics = n_topics;
+    checkpoint.n_documents = n_documents;
+    checkpoint.sync_period = sync_period;
+    checkpoint.shards.reserve(thread_idx.size());
+    for(const std::size_t ti : thread_idx) {
+        checkpoint.shards.push_back(tokens[ti]);
+    }
+
+    write(std::move(checkpoint));
+}
+
+void checkpoint_writer::iteration_done(const std::size_t i, const std::size_t iterations, token_topics const& tokens) {
+    if(!due(i, iterations)) {
+        return;
+    }
+
+    training_checkpoint checkpoint;
+    checkpoint.iterations = i + 1;
+    checkpoint.seed = seed;
+    checkpoint.n_topics = n_topics;
+    checkpoint.n_documents = n_documents;
+    checkpoint.shards.push_back(tokens);
+
+    write(std::move(checkpoint));
+}
+
+void checkpoint_writer::wait() {
+    if(writing.joinable()) {
+        writing.join();
+    }
+}
+
+void checkpoint_writer::write(training_checkpoint && checkpoint) {
+    wait();
+
+    writing = std::thread([this, checkpoint = std::move(checkpoint)]() {
+        if(!write_checkpoint(path, checkpoint)) {
+            std::cerr << "could not write the checkpoint '" << path << "' after iteration " << checkpoint.iterations << std::endl;
+        }
+    });
+}
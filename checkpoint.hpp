@@ -0,0 +1,119 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __MINIATURIST_CHECKPOINT_HPP__
+#define __MINIATURIST_CHECKPOINT_HPP__
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <cstdint>
+
+#include "token_topics.hpp"
+
+// checkpoints of a trainer's state at the end of an iteration
+//
+// a checkpoint holds the number of iterations done, the seed, and the
+// topic of every token (bit-packed as in token_topics) of a process or
+// locality, shards in order. that is all of the state: counter_rng
+// streams are keyed by (seed, iteration, token) and the count matrices
+// are sums over the tokens' topics, so a resumed trainer rebuilds tdcm
+// and twcm with count_init (gibbs.hpp) instead of storing them
+//
+// files are written to path.tmp and renamed to path; the checkpoint they
+// replace is kept at path.prev
+//
+
+// checkpoints are written to path every `every` iterations and after the
+// last one (none when path is empty); a trainer starts at first_iteration,
+// its tokens already holding the topics of a checkpoint taken there
+// (restore_checkpoint). sync_period is distpar_train_lda's merge period
+// at that checkpoint; 0 starts from the configured one
+//
+struct checkpoint_config {
+    std::string path;
+    std::size_t every;
+    std::size_t first_iteration;
+    std::size_t sync_period;
+
+    checkpoint_config() : path(), every(0), first_iteration(0), sync_period(0) {}
+};
+
+// sync_period is 0 for trainers that merge after every sweep
+//
+struct training_checkpoint {
+    std::uint64_t iterations;
+    std::uint64_t seed;
+    std::uint64_t n_topics;
+    std::uint64_t n_documents;
+    std::uint64_t sync_period;
+    std::vector< token_topics > shards;
+
+    training_checkpoint() : iterations(0), seed(0), n_topics(0), n_documents(0), sync_period(0), shards() {}
+};
+
+// false when the file can not be read or is not a complete checkpoint
+//
+bool read_checkpoint(std::string const& path, training_checkpoint & checkpoint);
+
+bool write_checkpoint(std::string const& path, training_checkpoint const& checkpoint);
+
+// the newest of path and path.prev that reads
+//
+bool read_latest_checkpoint(std::string const& path, training_checkpoint & checkpoint);
+
+// copies the checkpoint's topics into the shards of thread_idx (tokens of
+// all shards in order; the shards may be split differently than when the
+// checkpoint was taken). false when the number of topics, documents or
+// tokens differs
+//
+bool restore_checkpoint(training_checkpoint const& checkpoint, const std::size_t n_topics, const std::size_t n_documents,
+                   std::vector<std::size_t> const& thread_idx, std::vector< token_topics > & tokens);
+
+bool restore_checkpoint(training_checkpoint const& checkpoint, const std::size_t n_topics, const std::size_t n_documents, token_topics & tokens);
+
+// writes a trainer's checkpoints in the background; iteration_done copies
+// the topics and returns while a std::thread writes the file (an OS
+// thread, so the blocking file I/O never holds a worker of the HPX
+// trainers). a checkpoint waits for the write of the one before it
+//
+class checkpoint_writer {
+public:
+    checkpoint_writer(checkpoint_config const& config, const std::uint64_t seed, const std::size_t n_topics, const std::size_t n_documents);
+
+    ~checkpoint_writer();
+
+    // called after iteration i (counting from 0) of iterations; saves when
+    // a checkpoint is due
+    //
+    void iteration_done(const std::size_t i, const std::size_t iterations, std::vector<std::size_t> const& thread_idx, std::vector< token_topics > const& tokens);
+
+    void iteration_done(const std::size_t i, const std::size_t iterations, token_topics const& tokens);
+
+    // whether a checkpoint is due after iteration i, for trainers that
+    // save at iterations of their own choosing with save
+    //
+    bool due(const std::size_t i, const std::size_t iterations) const;
+
+    void save(const std::size_t i, std::vector<std::size_t> const& thread_idx, std::vector< token_topics > const& tokens, const std::size_t sync_period = 0);
+
+    // waits for the write in flight
+    //
+    void wait();
+
+private:
+    void write(training_checkpoint && checkpoint);
+
+    std::string path;
+    std::size_t every;
+    std::uint64_t seed;
+    std::uint64_t n_topics;
+    std::uint64_t n_documents;
+    std::thread writing;
+};
+
+#endif
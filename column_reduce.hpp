@@ -0,0 +1,104 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __MINIATURIST_COLUMN_REDUCE_HPP__
+#define __MINIATURIST_COLUMN_REDUCE_HPP__
+
+#include <hpx/config.hpp>
+#include <hpx/algorithm.hpp>
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <cstdint>
+
+#include "counts.hpp"
+
+// parallel in-place sum of the per-thread count matrices
+//
+// hpx::reduce with std::plus<count_matrix_t> allocates a K x V temporary
+// for every addition and, run in parallel, needs one partial sum per task.
+// here the columns are split into blocks and each task adds its block of
+// every replica straight into out, so there are no temporaries and every
+// core works on its own slice of all replicas. a block is sized to stay
+// in cache while the replicas are streamed through it
+//
+
+// columns per block for a target of n_blocks blocks, at least one column
+// and, when there are enough columns, about 256KB of counts per block
+//
+inline std::size_t column_block_width(count_matrix_t const& out, const std::size_t n_blocks) {
+    const std::size_t n_columns = out.columns();
+    const std::size_t column_bytes = std::max<std::size_t>(out.spacing() * sizeof(count_t), 1);
+    const std::size_t cache_width = std::max<std::size_t>((256 * 1024) / column_bytes, 1);
+    const std::size_t split_width = std::max<std::size_t>(n_columns / std::max<std::size_t>(n_blocks, 1), 1);
+    return std::min(cache_width, split_width);
+}
+
+// out = sum of replicas[i] for i in thread_idx; n_blocks is the minimum
+// number of blocks (parallel tasks), typically a small multiple of the
+// thread count
+//
+inline void column_block_reduce(std::vector<std::size_t> const& thread_idx,
+                                std::vector< count_matrix_t > const& replicas,
+                                count_matrix_t & out,
+                                const std::size_t n_blocks) {
+
+    const std::size_t n_topics = out.rows();
+    const std::size_t n_columns = out.columns();
+    const std::size_t width = column_block_width(out, n_blocks);
+
+    std::vector<std::size_t> blocks((n_columns + width - 1) / width);
+    std::iota(std::begin(blocks), std::end(blocks), 0);
+
+    hpx::for_each(hpx::execution::par, std::begin(blocks), std::end(blocks), [&thread_idx, &replicas, &out, n_topics, n_columns, width](const std::size_t b) {
+        const std::size_t first = b * width;
+        const std::size_t last = std::min(first + width, n_columns);
+
+        for(std::size_t c = first; c < last; ++c) {
+            std::fill_n(out.data(c), n_topics, 0);
+        }
+
+        for(const std::size_t ti : thread_idx) {
+            for(std::size_t c = first; c < last; ++c) {
+                const count_t * src = replicas[ti].data(c);
+                count_t * dst = out.data(c);
+                for(std::size_t t = 0; t < n_topics; ++t) {
+                    dst[t] += src[t];
+                }
+            }
+        }
+    });
+}
+
+// copies src into every replica, column block by column block
+//
+inline void column_block_broadcast(std::vector<std::size_t> const& thread_idx,
+                                   count_matrix_t const& src,
+                                   std::vector< count_matrix_t > & replicas,
+                                   const std::size_t n_blocks) {
+
+    const std::size_t n_topics = src.rows();
+    const std::size_t n_columns = src.columns();
+    const std::size_t width = column_block_width(src, n_blocks);
+
+    std::vector<std::size_t> blocks((n_columns + width - 1) / width);
+    std::iota(std::begin(blocks), std::end(blocks), 0);
+
+    hpx::for_each(hpx::execution::par, std::begin(blocks), std::end(blocks), [&thread_idx, &src, &replicas, n_topics, n_columns, width](const std::size_t b) {
+        const std::size_t first = b * width;
+        const std::size_t last = std::min(first + width, n_columns);
+
+        for(const std::size_t ti : thread_idx) {
+            for(std::size_t c = first; c < last; ++c) {
+                std::copy_n(src.data(c), n_topics, replicas[ti].data(c));
+            }
+        }
+    });
+}
+
+#endif
@@ -0,0 +1,119 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <hpx/config.hpp>
+#include <hpx/hpx.hpp>
+#include <hpx/modules/collectives.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+
+#include "corpus_manifest.hpp"
+#include "documents.hpp"
+
+using namespace hpx::collectives;
+
+bool read_manifest(std::string const& pth, corpus_manifest & manifest) {
+    std::ifstream istrm(pth);
+    if(!istrm.is_open()) {
+        return false;
+    }
+
+    manifest.paths.clear();
+    manifest.weights.clear();
+
+    std::string line;
+    while(std::getline(istrm, line)) {
+        if(line.empty()) {
+            continue;
+        }
+
+        const std::size_t tab = line.find('\t');
+        if(tab == std::string::npos || tab == 0 || tab + 1 == line.size()) {
+            return false;
+        }
+
+        std::uint64_t weight = 0;
+        for(std::size_t c = 0; c < tab; ++c) {
+            if(line[c] < '0' || line[c] > '9') {
+                return false;
+            }
+            weight = weight * 10 + static_cast<std::uint64_t>(line[c] - '0');
+        }
+
+        manifest.weights.push_back(weight);
+        manifest.paths.push_back(line.substr(tab + 1));
+    }
+
+    return true;
+}
+
+bool write_manifest(std::string const& pth, corpus_manifest const& manifest) {
+    std::ofstream ostrm(pth);
+    if(!ostrm.is_open()) {
+        return false;
+    }
+
+    const std::size_t n_paths = manifest.paths.size();
+    for(std::size_t p = 0; p < n_paths; ++p) {
+        ostrm << manifest.weights[p] << '\t' << manifest.paths[p] << '\n';
+    }
+
+    return static_cast<bool>(ostrm);
+}
+
+void partition_manifest(corpus_manifest const& manifest, const std::size_t n_parts, std::vector<corpus_manifest> & parts) {
+    const std::vector<std::size_t> weights(std::begin(manifest.weights), std::end(manifest.weights));
+
+    std::vector<std::size_t> bounds;
+    balanced_partition(weights, n_parts, bounds);
+
+    parts.assign(n_parts, corpus_manifest{});
+    for(std::size_t p = 0; p < n_parts; ++p) {
+        parts[p].paths.assign(std::begin(manifest.paths) + bounds[p], std::begin(manifest.paths) + bounds[p+1]);
+        parts[p].weights.assign(std::begin(manifest.weights) + bounds[p], std::begin(manifest.weights) + bounds[p+1]);
+    }
+}
+
+corpus_manifest scatter_manifest(const std::size_t n_locales, const std::size_t locality_id,
+                   std::string const& manifest_path,
+                   std::function<void(corpus_manifest &)> const& list) {
+
+    const std::string scatter_manifest_basename = "scatter_manifest";
+    auto scatter_manifest_client = create_communicator(
+        scatter_manifest_basename.c_str(), num_sites_arg(n_locales), this_site_arg(locality_id)
+    );
+
+    if(locality_id != 0) {
+        return scatter_from<corpus_manifest>(scatter_manifest_client, this_site_arg(locality_id)).get();
+    }
+
+    // an existing manifest that can not be read is left alone
+    //
+    corpus_manifest manifest;
+    const bool exists = !manifest_path.empty() && fs::exists(fs::path{manifest_path});
+    if(!exists || !read_manifest(manifest_path, manifest)) {
+        if(exists) {
+            std::cerr << "could not read the corpus manifest '" << manifest_path << "', listing the corpus instead" << std::endl;
+        }
+
+        manifest = corpus_manifest{};
+        list(manifest);
+
+        if(!exists && !manifest_path.empty() && !write_manifest(manifest_path, manifest)) {
+            std::cerr << "could not write the corpus manifest '" << manifest_path << "'" << std::endl;
+        }
+    }
+
+    std::vector<corpus_manifest> parts;
+    partition_manifest(manifest, n_locales, parts);
+
+    return scatter_to(scatter_manifest_client, std::move(parts), this_site_arg(locality_id)).get();
+}
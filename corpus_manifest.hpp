@@ -0,0 +1,64 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __MINIATURIST_CORPUS_MANIFEST_HPP__
+#define __MINIATURIST_CORPUS_MANIFEST_HPP__
+
+#include <hpx/config.hpp>
+#include <hpx/serialization/string.hpp>
+#include <hpx/serialization/vector.hpp>
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+// which corpus files each locality indexes
+//
+// locality 0 lists the corpus (or reads a manifest file listing it) and
+// hands every locality the contiguous run of files it should index,
+// balanced by weight, so the corpus directory is walked once instead of
+// by every locality
+//
+
+// corpus files and their weights, in listing order; a weight is the file
+// size in bytes or any count known ahead of time (tokens, say)
+//
+struct corpus_manifest {
+    std::vector<std::string> paths;
+    std::vector<std::uint64_t> weights;
+
+    template<typename Archive>
+    void serialize(Archive & ar, unsigned) {
+        ar & paths & weights;
+    }
+};
+
+// a manifest file holds one "weight<tab>path" line per corpus file; both
+// return false when the file can not be read (or written) or a line is
+// malformed
+//
+bool read_manifest(std::string const& pth, corpus_manifest & manifest);
+
+bool write_manifest(std::string const& pth, corpus_manifest const& manifest);
+
+// splits manifest into n_parts contiguous runs of files of about equal
+// weight (balanced_partition in documents.hpp)
+//
+void partition_manifest(corpus_manifest const& manifest, const std::size_t n_parts, std::vector<corpus_manifest> & parts);
+
+// returns this locality's part of the corpus; called on every locality.
+// locality 0 reads manifest_path when it names an existing manifest and
+// otherwise runs list, which fills in the corpus files and their sizes,
+// writing the result to manifest_path (when not empty and not already
+// there) for later runs. each locality receives only its own part
+//
+corpus_manifest scatter_manifest(const std::size_t n_locales, const std::size_t locality_id,
+                   std::string const& manifest_path,
+                   std::function<void(corpus_manifest &)> const& list);
+
+#endif
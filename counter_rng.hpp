@@ -0,0 +1,143 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __MINIATURIST_COUNTER_RNG_HPP__
+#define __MINIATURIST_COUNTER_RNG_HPP__
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+// Philox4x32-10 (Salmon, Moraes, Dror, Shaw 2011); a keyed bijection of a
+// 128 bit counter, so any block of the stream is computed directly from
+// its counter without stepping through the ones before it
+//
+struct philox4x32 {
+    static constexpr std::uint32_t M0 = 0xD2511F53U;
+    static constexpr std::uint32_t M1 = 0xCD9E8D57U;
+    static constexpr std::uint32_t W0 = 0x9E3779B9U;
+    static constexpr std::uint32_t W1 = 0xBB67AE85U;
+
+    static inline void block(std::uint32_t k0, std::uint32_t k1,
+                             std::uint32_t & c0, std::uint32_t & c1, std::uint32_t & c2, std::uint32_t & c3) {
+        for(int r = 0; r < 10; ++r) {
+            const std::uint64_t p0 = static_cast<std::uint64_t>(M0) * c0;
+            const std::uint64_t p1 = static_cast<std::uint64_t>(M1) * c2;
+            const std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1 ^ k0;
+            const std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3 ^ k1;
+            c1 = static_cast<std::uint32_t>(p1);
+            c3 = static_cast<std::uint32_t>(p0);
+            c0 = n0;
+            c2 = n2;
+            k0 += W0;
+            k1 += W1;
+        }
+    }
+
+    // double in [0, 1) with 52 random mantissa bits; built with integer
+    // operations (as erand48 does) so batches vectorize without a
+    // 64 bit integer to double conversion instruction
+    //
+    static inline double to_unit(const std::uint32_t hi, const std::uint32_t lo) {
+        const std::uint64_t x = 0x3FF0000000000000ULL | (((static_cast<std::uint64_t>(hi) << 32) | lo) >> 12);
+        double f;
+        std::memcpy(&f, &x, sizeof(f));
+        return f - 1.0;
+    }
+};
+
+// uniform doubles for the samplers, keyed by (seed, iteration, token)
+//
+// every token of the corpus has its own stream; the j-th block of token
+// t in iteration i is philox(seed; j, t lo, t hi, i) and yields two
+// uniforms. t is the token's global position (documents in corpus order,
+// tokens in document order), so a token's draws do not depend on which
+// thread or locality samples it or on how the corpus is sharded
+//
+// usage by a kernel: sweep(i) once per iteration, prefetch(first, n) for
+// the tokens of a document, which generates the first block of each of
+// them in one batch, then seek(pos) before drawing for the token at
+// shard position pos
+//
+struct counter_rng {
+    // iteration number reserved for the random initial assignment
+    //
+    static constexpr std::uint32_t init_sweep = 0xFFFFFFFFU;
+
+    std::uint32_t key[2];
+    std::uint32_t iteration;
+
+    // global position of the shard's first token
+    //
+    std::uint64_t token_offset;
+
+    std::vector<double> batch;
+    std::size_t batch_first, batch_size;
+
+    std::uint64_t token;
+    std::uint32_t draw;
+    bool batched;
+    double spare;
+
+    explicit counter_rng(const std::uint64_t seed = 0, const std::uint64_t offset = 0) :
+        key{ static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32) },
+        iteration(0), token_offset(offset), batch(), batch_first(0), batch_size(0),
+        token(offset), draw(0), batched(false), spare(0.0) {
+    }
+
+    void sweep(const std::uint32_t i) {
+        iteration = i;
+        batch_size = 0;
+    }
+
+    void prefetch(const std::size_t first, const std::size_t n) {
+        if(batch.size() < (2 * n)) {
+            batch.resize(2 * n);
+        }
+
+        const std::uint32_t k0 = key[0], k1 = key[1], it = iteration;
+        const std::uint64_t t0 = token_offset + first;
+        double * out = batch.data();
+
+        // no dependency between iterations; the compiler vectorizes this
+        //
+        for(std::size_t i = 0; i < n; ++i) {
+            const std::uint64_t t = t0 + i;
+            std::uint32_t c0 = 0, c1 = static_cast<std::uint32_t>(t), c2 = static_cast<std::uint32_t>(t >> 32), c3 = it;
+            philox4x32::block(k0, k1, c0, c1, c2, c3);
+            out[2*i] = philox4x32::to_unit(c0, c1);
+            out[(2*i)+1] = philox4x32::to_unit(c2, c3);
+        }
+
+        batch_first = first;
+        batch_size = n;
+    }
+
+    void seek(const std::size_t pos) {
+        token = token_offset + pos;
+        draw = 0;
+        batched = (pos >= batch_first) && ((pos - batch_first) < batch_size);
+    }
+
+    double operator()() {
+        const std::uint32_t j = draw++;
+
+        if(batched && j < 2) {
+            return batch[(2 * static_cast<std::size_t>(token - token_offset - batch_first)) + j];
+        }
+        else if((j & 1U) == 1U) {
+            return spare;
+        }
+
+        std::uint32_t c0 = j >> 1, c1 = static_cast<std::uint32_t>(token), c2 = static_cast<std::uint32_t>(token >> 32), c3 = iteration;
+        philox4x32::block(key[0], key[1], c0, c1, c2, c3);
+        spare = philox4x32::to_unit(c2, c3);
+        return philox4x32::to_unit(c0, c1);
+    }
+};
+
+#endif
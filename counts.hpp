@@ -0,0 +1,99 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __HPXLDA_COUNTS_HPP__
+#define __HPXLDA_COUNTS_HPP__
+
+#include <cstdint>
+
+#include <blaze/Math.h>
+
+// storage types for the model's count state
+//
+// counts are integers; the samplers convert to double only where a
+// probability is computed. count_t is signed because the parallel
+// trainers store per-thread differences (twcm[i] - twcm_base) in the
+// same matrices
+//
+using count_t = std::int32_t;
+
+// document-word-count-matrix (dwcm)
+using sparse_count_matrix_t = blaze::CompressedMatrix<count_t>;
+
+// topic-document-count-matrix (tdcm), topic-word-count-matrix (twcm)
+//
+// both are n_topics x (documents|words) and stored column-major so the
+// topic counts of one document or one word, the values a sampler reads
+// for every token, are one contiguous (SIMD aligned and padded) run of
+// memory instead of a stride of (documents|words) elements
+//
+using count_matrix_t = blaze::DynamicMatrix<count_t, blaze::columnMajor>;
+
+// topic totals (ztot)
+//
+// a topic's total, like the token count of a corpus, can pass 2^31 on
+// the corpora the distributed trainers are run on, so totals are kept
+// and summed in a wider type than the counts they add up
+//
+using total_t = std::int64_t;
+using count_vector_t = blaze::DynamicVector<total_t>;
+
+// topic totals of a topic-(document|word) count matrix; sums in total_t,
+// where blaze::sum<blaze::rowwise> would accumulate in count_t
+//
+inline count_vector_t topic_totals(count_matrix_t const& m) {
+    const std::size_t n_topics = m.rows();
+    count_vector_t totals(n_topics, 0);
+    for(std::size_t c = 0; c < m.columns(); ++c) {
+        const count_t * col = m.data(c);
+        for(std::size_t t = 0; t < n_topics; ++t) {
+            totals[t] += col[t];
+        }
+    }
+    return totals;
+}
+
+// c += v; atomic (relaxed) when other threads update the same matrix, see
+// model_sharing in gibbs.hpp. returns the updated count
+//
+template<bool Atomic>
+inline count_t add_count(count_t & c, const count_t v) {
+    if constexpr(Atomic) {
+        return __atomic_add_fetch(&c, v, __ATOMIC_RELAXED);
+    }
+    else {
+        c += v;
+        return c;
+    }
+}
+
+template<bool Atomic>
+inline total_t add_count(total_t & c, const total_t v) {
+    if constexpr(Atomic) {
+        return __atomic_add_fetch(&c, v, __ATOMIC_RELAXED);
+    }
+    else {
+        c += v;
+        return c;
+    }
+}
+
+inline count_t add_count(count_t & c, const count_t v, const bool atomic) {
+    return atomic ? add_count<true>(c, v) : add_count<false>(c, v);
+}
+
+// reads a count other threads update with add_count<true>
+//
+inline count_t load_count(count_t const& c) {
+    return __atomic_load_n(&c, __ATOMIC_RELAXED);
+}
+
+inline total_t load_count(total_t const& c) {
+    return __atomic_load_n(&c, __ATOMIC_RELAXED);
+}
+
+#endif
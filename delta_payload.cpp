@@ -0,0 +1,249 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include <blaze/Math.h>
+
+#include "delta_payload.hpp"
+
+static inline void put_varint(std::vector<std::uint8_t> & s, std::uint64_t v) {
+    while(v >= 0x80) {
+        s.push_back(static_cast<std::uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    s.push_back(static_cast<std::uint8_t>(v));
+}
+
+// appends entries to a sparse payload in index order
+//
+struct delta_writer {
+    delta_payload & out;
+    std::uint64_t next;
+
+    explicit delta_writer(delta_payload & p) : out(p), next(0) {
+        out.dense = false;
+        out.nonzeros = 0;
+        out.stream.clear();
+        out.values.clear();
+    }
+
+    void put(const std::uint64_t idx, const count_t v) {
+        const std::int64_t sv = static_cast<std::int64_t>(v);
+        put_varint(out.stream, idx - next);
+        put_varint(out.stream, (static_cast<std::uint64_t>(sv) << 1) ^ static_cast<std::uint64_t>(sv >> 63));
+        next = idx + 1;
+        ++out.nonzeros;
+    }
+
+    // true once the stream is no smaller than the dense counts
+    //
+    bool too_large() const {
+        return out.stream.size() >= (out.n_entries() * sizeof(count_t));
+    }
+};
+
+// rewrites p as dense counts
+//
+static void densify(delta_payload & p) {
+    if(p.dense) {
+        return;
+    }
+
+    std::vector<count_t> values(p.n_entries(), 0);
+    const std::uint64_t n_topics = p.n_topics;
+    const std::size_t first_word = static_cast<std::size_t>(p.first_word);
+    for_each_delta(p, [&values, n_topics, first_word](const std::size_t w, const std::size_t t, const count_t v) {
+        values[(w - first_word) * n_topics + t] = v;
+    });
+
+    p.values = std::move(values);
+    p.stream.clear();
+    p.stream.shrink_to_fit();
+    p.dense = true;
+}
+
+// encodes columns of diff as payload words; column columns[j] of diff is
+// payload word word_of(j), counted from the payload's first word
+//
+template<typename WordOf>
+static void encode_words(count_matrix_t const& diff, std::vector<std::size_t> const& columns, WordOf && word_of, delta_payload & out) {
+    const std::uint64_t n_topics = out.n_topics;
+    const std::size_t n_columns = columns.size();
+    delta_writer writer(out);
+
+    for(std::size_t j = 0; j < n_columns; ++j) {
+        const std::uint64_t w = word_of(j);
+        const count_t * diff_w = diff.data(columns[j]);
+        for(std::size_t t = 0; t < n_topics; ++t) {
+            if(diff_w[t] != 0) {
+                writer.put(w * n_topics + t, diff_w[t]);
+            }
+        }
+
+        if(writer.too_large()) {
+            break;
+        }
+    }
+
+    if(!writer.too_large()) {
+        return;
+    }
+
+    // most entries are nonzero; send the dense counts
+    //
+    out.stream.clear();
+    out.values.assign(out.n_entries(), 0);
+    for(std::size_t j = 0; j < n_columns; ++j) {
+        std::copy_n(diff.data(columns[j]), n_topics, out.values.data() + word_of(j) * n_topics);
+    }
+    out.nonzeros = static_cast<std::uint64_t>(std::count_if(std::begin(out.values), std::end(out.values), [](const count_t c) { return c != 0; }));
+    out.dense = true;
+}
+
+void encode_delta(count_matrix_t const& diff, std::vector<std::size_t> const& columns, delta_payload & out) {
+    encode_delta(diff, columns, 0, diff.columns(), out);
+}
+
+void encode_delta(count_matrix_t const& diff, std::vector<std::size_t> const& columns,
+                  const std::size_t first_word, const std::size_t last_word, delta_payload & out) {
+    out.n_topics = diff.rows();
+    out.first_word = first_word;
+    out.n_words = last_word - first_word;
+
+    encode_words(diff, columns, [&columns, first_word](const std::size_t j) { return static_cast<std::uint64_t>(columns[j] - first_word); }, out);
+}
+
+void encode_columns(count_matrix_t const& diff, std::vector<std::size_t> const& columns, delta_payload & out) {
+    out.n_topics = diff.rows();
+    out.first_word = 0;
+    out.n_words = columns.size();
+
+    encode_words(diff, columns, [](const std::size_t j) { return static_cast<std::uint64_t>(j); }, out);
+}
+
+delta_payload delta_adder::operator()(delta_payload const& a, delta_payload const& b) const {
+    delta_payload sum;
+    sum.n_topics = a.n_topics;
+    sum.first_word = a.first_word;
+    sum.n_words = a.n_words;
+
+    const std::size_t first_word = static_cast<std::size_t>(a.first_word);
+
+    if(a.dense || b.dense) {
+        sum = a.dense ? a : b;
+        densify(sum);
+        const std::uint64_t n_topics = sum.n_topics;
+        for_each_delta(a.dense ? b : a, [&sum, n_topics, first_word](const std::size_t w, const std::size_t t, const count_t v) {
+            sum.values[(w - first_word) * n_topics + t] += v;
+        });
+        sum.nonzeros = static_cast<std::uint64_t>(std::count_if(std::begin(sum.values), std::end(sum.values), [](const count_t c) { return c != 0; }));
+        return sum;
+    }
+
+    // merge the two index ordered entry lists; entries that cancel out
+    // are dropped
+    //
+    std::vector<std::uint64_t> a_idx, b_idx;
+    std::vector<count_t> a_val, b_val;
+    a_idx.reserve(a.nonzeros); a_val.reserve(a.nonzeros);
+    b_idx.reserve(b.nonzeros); b_val.reserve(b.nonzeros);
+
+    const std::uint64_t n_topics = a.n_topics;
+    for_each_delta(a, [&a_idx, &a_val, n_topics, first_word](const std::size_t w, const std::size_t t, const count_t v) {
+        a_idx.push_back(static_cast<std::uint64_t>(w - first_word) * n_topics + t);
+        a_val.push_back(v);
+    });
+    for_each_delta(b, [&b_idx, &b_val, n_topics, first_word](const std::size_t w, const std::size_t t, const count_t v) {
+        b_idx.push_back(static_cast<std::uint64_t>(w - first_word) * n_topics + t);
+        b_val.push_back(v);
+    });
+
+    delta_writer writer(sum);
+    sum.stream.reserve(a.stream.size() + b.stream.size());
+
+    std::size_t i = 0, j = 0;
+    const std::size_t n_a = a_idx.size(), n_b = b_idx.size();
+    while(i < n_a || j < n_b) {
+        if(j == n_b || (i < n_a && a_idx[i] < b_idx[j])) {
+            writer.put(a_idx[i], a_val[i]);
+            ++i;
+        }
+        else if(i == n_a || b_idx[j] < a_idx[i]) {
+            writer.put(b_idx[j], b_val[j]);
+            ++j;
+        }
+        else {
+            const count_t v = a_val[i] + b_val[j];
+            if(v != 0) {
+                writer.put(a_idx[i], v);
+            }
+            ++i;
+            ++j;
+        }
+    }
+
+    if(writer.too_large()) {
+        densify(sum);
+    }
+
+    return sum;
+}
+
+void split_delta(delta_payload const& p, std::vector<std::size_t> const& bounds, std::vector<delta_payload> & parts) {
+    const std::size_t n_parts = bounds.size() - 1;
+    const std::uint64_t n_topics = p.n_topics;
+
+    parts.assign(n_parts, delta_payload{});
+    std::vector<delta_writer> writers;
+    writers.reserve(n_parts);
+    for(std::size_t c = 0; c < n_parts; ++c) {
+        parts[c].n_topics = n_topics;
+        parts[c].first_word = bounds[c];
+        parts[c].n_words = bounds[c+1] - bounds[c];
+        writers.emplace_back(parts[c]);
+    }
+
+    // entries are in word order, so the part only moves forward
+    //
+    std::size_t part = 0;
+    for_each_delta(p, [&writers, &bounds, &part, n_parts, n_topics](const std::size_t w, const std::size_t t, const count_t v) {
+        while(part < n_parts && w >= bounds[part+1]) {
+            ++part;
+        }
+        writers[part].put(static_cast<std::uint64_t>(w - bounds[part]) * n_topics + t, v);
+    });
+
+    for(std::size_t c = 0; c < n_parts; ++c) {
+        if(writers[c].too_large()) {
+            densify(parts[c]);
+        }
+    }
+}
+
+void join_delta(std::vector<delta_payload> const& parts, std::vector<std::size_t> const& bounds, delta_payload & out) {
+    const std::size_t n_parts = parts.size();
+    const std::size_t first_word = bounds.front();
+
+    out.n_topics = parts.empty() ? 0 : parts[0].n_topics;
+    out.first_word = first_word;
+    out.n_words = bounds.back() - first_word;
+
+    const std::uint64_t n_topics = out.n_topics;
+    delta_writer writer(out);
+
+    for(std::size_t c = 0; c < n_parts; ++c) {
+        for_each_delta(parts[c], [&writer, first_word, n_topics](const std::size_t w, const std::size_t t, const count_t v) {
+            writer.put(static_cast<std::uint64_t>(w - first_word) * n_topics + t, v);
+        });
+    }
+
+    if(writer.too_large()) {
+        densify(out);
+    }
+}
@@ -0,0 +1,136 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __MINIATURIST_DELTA_PAYLOAD_HPP__
+#define __MINIATURIST_DELTA_PAYLOAD_HPP__
+
+#include <hpx/config.hpp>
+#include <hpx/serialization/vector.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "counts.hpp"
+
+// topic-word count differences exchanged by distpar_train_lda's
+// all_reduce (and pushed to the sharded model's servers), in the smaller
+// of two encodings
+//
+// a payload covers the n_words words [first_word, first_word + n_words)
+// of the model, which may be a slice of the vocabulary. entry (t, w) has
+// the linear index (w - first_word) * K + t. sparse payloads hold only
+// the nonzero entries, in index order, as a byte stream of varint(index
+// gap) followed by varint(zigzag(value)) per entry; gaps and small counts
+// take one or two bytes instead of the four of a dense count. dense
+// payloads hold all K x n_words counts (without blaze's padding). a
+// payload is made sparse and switches to dense as soon as the stream
+// would be larger, which happens when most entries of its words are
+// nonzero
+//
+struct delta_payload {
+    std::uint64_t n_topics;
+    std::uint64_t first_word;
+    std::uint64_t n_words;
+    std::uint64_t nonzeros;
+    bool dense;
+    std::vector<std::uint8_t> stream;
+    std::vector<count_t> values;
+
+    delta_payload() : n_topics(0), first_word(0), n_words(0), nonzeros(0), dense(false), stream(), values() {}
+
+    std::uint64_t n_entries() const {
+        return n_topics * n_words;
+    }
+
+    // bytes of the encoded differences
+    //
+    std::uint64_t bytes() const {
+        return dense ? (values.size() * sizeof(count_t)) : stream.size();
+    }
+
+    template<typename Archive>
+    void serialize(Archive & ar, unsigned) {
+        ar & n_topics & first_word & n_words & nonzeros & dense & stream & values;
+    }
+};
+
+// encodes columns (sorted, unique) of diff; every other column of diff
+// must be zero
+//
+void encode_delta(count_matrix_t const& diff, std::vector<std::size_t> const& columns, delta_payload & out);
+
+// encodes columns (sorted, unique, all in [first_word, last_word)) of diff
+// as a payload of words [first_word, last_word); every other column of
+// diff in that range must be zero
+//
+void encode_delta(count_matrix_t const& diff, std::vector<std::size_t> const& columns,
+                  const std::size_t first_word, const std::size_t last_word, delta_payload & out);
+
+// encodes columns (sorted, unique) of diff as a payload of columns.size()
+// words; payload word j is column columns[j] of diff. used to push the
+// differences of a subset of the words (param_server.hpp)
+//
+void encode_columns(count_matrix_t const& diff, std::vector<std::size_t> const& columns, delta_payload & out);
+
+// sum of two payloads of the same words; the reduction of the all_reduce
+//
+struct delta_adder {
+    delta_payload operator()(delta_payload const& a, delta_payload const& b) const;
+};
+
+// splits p by word (bounds as in balanced_partition, every word of p in
+// [bounds.front(), bounds.back())); part c is the payload of words
+// [bounds[c], bounds[c+1])
+//
+void split_delta(delta_payload const& p, std::vector<std::size_t> const& bounds, std::vector<delta_payload> & parts);
+
+// the inverse of split_delta, a payload of words [bounds.front(),
+// bounds.back())
+//
+void join_delta(std::vector<delta_payload> const& parts, std::vector<std::size_t> const& bounds, delta_payload & out);
+
+// calls f(w, t, v) for every nonzero entry in index order; w is the
+// model's word, first_word included
+//
+template<typename F>
+void for_each_delta(delta_payload const& p, F && f) {
+    const std::uint64_t n_topics = p.n_topics;
+    const std::size_t first_word = static_cast<std::size_t>(p.first_word);
+
+    if(p.dense) {
+        const std::uint64_t n = p.values.size();
+        for(std::uint64_t i = 0; i < n; ++i) {
+            if(p.values[i] != 0) {
+                f(first_word + static_cast<std::size_t>(i / n_topics), static_cast<std::size_t>(i % n_topics), p.values[i]);
+            }
+        }
+        return;
+    }
+
+    const std::uint8_t * s = p.stream.data();
+    const std::uint8_t * s_end = s + p.stream.size();
+    std::uint64_t idx = 0;
+
+    while(s < s_end) {
+        std::uint64_t gap = 0, zz = 0;
+        for(unsigned int shift = 0; ; shift += 7) {
+            gap |= static_cast<std::uint64_t>(*s & 0x7F) << shift;
+            if((*s++ & 0x80) == 0) { break; }
+        }
+        for(unsigned int shift = 0; ; shift += 7) {
+            zz |= static_cast<std::uint64_t>(*s & 0x7F) << shift;
+            if((*s++ & 0x80) == 0) { break; }
+        }
+
+        idx += gap;
+        const count_t v = static_cast<count_t>(static_cast<std::int64_t>(zz >> 1) ^ -static_cast<std::int64_t>(zz & 1));
+        f(first_word + static_cast<std::size_t>(idx / n_topics), static_cast<std::size_t>(idx % n_topics), v);
+        ++idx;
+    }
+}
+
+#endif
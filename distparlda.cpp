@@ -26,6 +26,10 @@
 #include "gibbs.hpp"
 #include "documents.hpp"
 #include "results.hpp"
+#include "rebalance.hpp"
+#include "shard_placement.hpp"
+#include "corpus_manifest.hpp"
+#include "checkpoint.hpp"
 #include "serialize.hpp"
 
 namespace fs = std::experimental::filesystem;
@@ -62,6 +66,11 @@ int hpx_main(hpx::program_options::variables_map & vm) {
         jsonprefix = vm["json"].as<std::string>();
     }
 
+    std::string manifest_path{};
+    if(vm.count("manifest") > 0) {
+        manifest_path = vm["manifest"].as<std::string>();
+    }
+
     UnicodeString regexp(UnicodeString::fromUTF8(vm["regex"].as<std::string>())); //u"[\\p{L}\\p{M}]+");
 
     fs::path pth{vm["corpus_dir"].as<std::string>()};
@@ -72,6 +81,80 @@ int hpx_main(hpx::program_options::variables_map & vm) {
     const double alpha = vm["alpha"].as<double>();
     const double beta = vm["beta"].as<double>();
 
+    sampler_type sampler = sampler_type::dense;
+    if(!sampler_from_string(vm["sampler"].as<std::string>(), sampler)) {
+        std::cerr << "Please specify '--sampler=[dense|sparse|alias]'" << std::endl;
+        return hpx::finalize();
+    }
+
+    const std::uint64_t seed = vm["seed"].as<std::uint64_t>();
+
+    const bool numa_report = (vm.count("numa_report") > 0);
+    const std::size_t pipeline_slices = vm["pipeline"].as<std::size_t>();
+
+    const double rebalance = vm["rebalance"].as<double>();
+    if(rebalance < 0.0) {
+        std::cerr << "Please specify '--rebalance=non-negative-value'" << std::endl;
+        return hpx::finalize();
+    }
+
+    // the topic-word model is either a full copy per thread
+    // (distpar_train_lda) or sharded by word across the localities
+    // (sharded_train_lda)
+    //
+    const std::string model = vm["model"].as<std::string>();
+    if(model != "replicated" && model != "sharded") {
+        std::cerr << "Please specify '--model=[replicated|sharded]'" << std::endl;
+        return hpx::finalize();
+    }
+
+    reduce_algorithm reduction = reduce_algorithm::automatic;
+    if(!reduce_algorithm_from_string(vm["reduce"].as<std::string>(), reduction)) {
+        std::cerr << "Please specify '--reduce=[auto|flat|hierarchical]'" << std::endl;
+        return hpx::finalize();
+    }
+
+    const std::size_t sync_every = vm["sync_every"].as<std::size_t>();
+    if(sync_every < 1) {
+        std::cerr << "Please specify '--sync_every=positive-integer-value'" << std::endl;
+        return hpx::finalize();
+    }
+
+    const double sync_tolerance = vm["sync_adaptive"].as<double>();
+    if(sync_tolerance < 0.0) {
+        std::cerr << "Please specify '--sync_adaptive=non-negative-value'" << std::endl;
+        return hpx::finalize();
+    }
+
+    // every locality checkpoints the topics of its own tokens to
+    // --checkpoint followed by its locality id (checkpoint.hpp)
+    //
+    std::string checkpoint_prefix{};
+    if(vm.count("checkpoint") > 0) {
+        checkpoint_prefix = vm["checkpoint"].as<std::string>();
+    }
+
+    const bool resume = (vm.count("resume") > 0);
+    if(resume && checkpoint_prefix.size() < 1) {
+        std::cerr << "'--resume' requires '--checkpoint=checkpoint-file-prefix'" << std::endl;
+        return hpx::finalize();
+    }
+
+    const bool sharded = (model == "sharded");
+
+    // the sparse sampler indexes each word's topics per thread, which the
+    // other threads sampling the locality's columns would leave stale
+    //
+    if(sharded && sampler == sampler_type::sparse) {
+        std::cerr << "'--model=sharded' does not support '--sampler=sparse'" << std::endl;
+        return hpx::finalize();
+    }
+
+    if(sharded && (rebalance > 0.0 || pipeline_slices > 0 || jsonprefix.size() > 0 || sync_every > 1 || sync_tolerance > 0.0 || checkpoint_prefix.size() > 0)) {
+        std::cerr << "'--model=sharded' does not support '--rebalance', '--pipeline', '--sync_every', '--sync_adaptive', '--checkpoint' or '--json'" << std::endl;
+        return hpx::finalize();
+    }
+
     const std::vector<hpx::id_type> localities = hpx::find_all_localities();
     const size_t n_locales = localities.size();
     const std::size_t locality_id = hpx::get_locality_id();
@@ -82,64 +165,135 @@ int hpx_main(hpx::program_options::variables_map & vm) {
 
     const std::size_t vocab_sz = load_wordlist(wpth, vocabulary);
 
-    std::vector< CompressedMatrix<double> > dwcm(n_threads);
-    std::vector< DynamicMatrix<double> > tdcm(n_threads), twcm(n_threads);
+    std::vector< sparse_count_matrix_t > dwcm(n_threads);
+    std::vector< count_matrix_t > tdcm(n_threads), twcm(n_threads);
 
     std::vector< std::size_t > thread_idx(n_threads);
     std::iota(std::begin(thread_idx), std::end(thread_idx), 0);
 
 
-    std::vector< std::vector<std::size_t> > tokens(n_threads);
+    std::vector< token_topics > tokens(n_threads);
     std::vector< std::tuple<std::size_t, std::size_t> > doc_chunks(n_threads);
 
     {
         std::vector< fs::path > paths;
 
-        // sort out locale file portion
+        // sort out locale file portion; locality 0 lists the corpus (or
+        // reads the manifest) and sends every locality its files. documents
+        // aren't indexed yet, so localities are balanced by file size as a
+        // proxy for token count (corpus_manifest.hpp)
         //
         {
-            std::vector< fs::path > locale_paths;
-            const std::size_t n_paths = path_to_vector( pth, locale_paths );
-            const std::size_t chunk_sz = n_paths / n_locales;
-            const std::size_t base = locality_id * chunk_sz;
-            const std::tuple<std::size_t, std::size_t> locale_dp{base, ( locality_id != (n_locales-1) ) ? (base + chunk_sz) : (n_paths-1) };
-            const std::size_t locale_doc_diff = std::get<1>(locale_dp)-std::get<0>(locale_dp);
-            paths.resize(locale_doc_diff);
-            std::copy_n(std::begin(locale_paths)+std::get<0>(locale_dp), locale_doc_diff, std::begin(paths));
+            const corpus_manifest locale_manifest = scatter_manifest(n_locales, locality_id, manifest_path, [&pth](corpus_manifest & manifest) {
+                std::vector< fs::path > corpus_paths;
+                path_to_vector( pth, corpus_paths );
+
+                std::vector< std::size_t > sizes;
+                path_sizes(corpus_paths, sizes);
+
+                manifest.paths.reserve(corpus_paths.size());
+                for(fs::path const& p : corpus_paths) {
+                    manifest.paths.push_back(p.string());
+                }
+                manifest.weights.assign(std::begin(sizes), std::end(sizes));
+            });
+
+            paths.assign(std::begin(locale_manifest.paths), std::end(locale_manifest.paths));
         }
 
-        const std::size_t n_paths = paths.size(); //path_to_vector( pth, paths );
-        const std::size_t chunk_sz = n_paths / n_threads;
+        const std::size_t n_paths = paths.size();
 
-        std::vector< fs::path >::iterator paths_itr = paths.begin();
-        std::vector< inverted_index_t > ii(n_threads);
+        // index this locality's documents once, then split them into
+        // contiguous shards holding about the same number of tokens
+        //
+        sparse_count_matrix_t locale_dwcm;
+        {
+            std::vector< fs::path >::iterator beg = paths.begin();
+            std::vector< fs::path >::iterator end = paths.end();
+            inverted_index_t ii;
+            document_path_to_inverted_index(beg, end, regexp, ii, vocabulary);
+            sparse_count_matrix_t wdcm;
+            inverted_index_to_matrix(vocabulary, ii, n_paths, wdcm);
+            locale_dwcm = blaze::trans(wdcm);
+        }
 
-        for(const std::size_t i : thread_idx) {
-            const std::size_t base = i * chunk_sz;
-            std::tuple<std::size_t, std::size_t> dp{base,  ( i != (n_threads-1) ) ? (base + chunk_sz) : n_paths};
-
-            const std::size_t doc_diff = std::get<1>(dp)-std::get<0>(dp);
-            tdcm[i].resize( n_topics, doc_diff );
-            twcm[i].resize( n_topics, vocab_sz );
-            tdcm[i] = 0.0;
-            twcm[i] = 0.0;
-
-            doc_chunks[i] = std::move(dp);
-
-            auto beg = paths_itr+std::get<0>(doc_chunks[i]);
-            auto end = paths_itr+std::get<1>(doc_chunks[i]);
-            document_path_to_inverted_index(beg, end, regexp, ii[i], vocabulary);
-            const std::size_t ndocs = static_cast<std::size_t>(end-beg);
-            inverted_index_to_matrix(vocabulary, ii[i], ndocs, dwcm[i]);
-            dwcm[i] = blaze::trans(dwcm[i]);
-            matrix_to_vector(dwcm[i], tokens[i]);
+        std::vector< std::size_t > doc_lens(n_paths), bounds;
+        for(std::size_t d = 0; d < n_paths; ++d) {
+            doc_lens[d] = doc_tokens(locale_dwcm, d);
         }
+
+        balanced_partition(doc_lens, n_threads, bounds);
+
+        // each shard's state is allocated and first touched by the worker
+        // that will sample it (shard_placement.hpp)
+        //
+        for_each_shard(thread_idx, [&](const std::size_t i) {
+            copy_rows(locale_dwcm, bounds[i], bounds[i+1], dwcm[i]);
+            doc_chunks[i] = std::make_tuple(bounds[i], bounds[i+1]);
+
+            tdcm[i].resize( n_topics, bounds[i+1] - bounds[i] );
+            tdcm[i] = 0;
+
+            // the sharded model keeps no per-thread copy
+            //
+            if(!sharded) {
+                twcm[i].resize( n_topics, vocab_sz );
+                twcm[i] = 0;
+            }
+
+            matrix_to_vector(dwcm[i], tokens[i], n_topics);
+
+            if(numa_report) {
+                report_placement("distparlda", i, shard_state_regions(dwcm[i], tdcm[i], twcm[i], tokens[i]));
+            }
+        });
     }
 
-    distpar_train_lda(n_locales, locality_id, thread_idx, dwcm, tdcm, twcm, tokens, n_topics, iterations, alpha, beta);
+    topic_word_server server;
+    if(sharded) {
+        server = create_topic_word_server(n_locales, locality_id, n_topics, vocab_sz);
+        sharded_train_lda(n_locales, locality_id, thread_idx, dwcm, tdcm, tokens, server, n_topics, iterations, alpha, beta, sampler, seed);
+    }
+    else {
+        checkpoint_config checkpoint;
+        if(checkpoint_prefix.size() > 0) {
+            checkpoint.path = checkpoint_prefix + "." + std::to_string(locality_id);
+        }
+        checkpoint.every = vm["checkpoint_every"].as<std::size_t>();
+
+        // with --resume the tokens take the topics of the newest checkpoint
+        // all localities hold and training continues after its iteration
+        //
+        if(resume && !resume_locality_checkpoint(n_locales, locality_id, checkpoint.path, seed, n_topics, thread_idx, dwcm, tokens, checkpoint)) {
+            if(locality_id == 0) {
+                std::cerr << "Could not resume from the checkpoints '" << checkpoint_prefix << ".*'; some locality has none of the same iteration, or one was taken with a different corpus, seed or number of topics" << std::endl;
+            }
+            return hpx::finalize();
+        }
+
+        distpar_train_lda(n_locales, locality_id, thread_idx, dwcm, tdcm, twcm, tokens, n_topics, iterations, alpha, beta, sampler, seed, rebalance, pipeline_slices, reduction, sync_every, sync_tolerance, checkpoint);
+    }
+
+    // rebalancing may have moved the shards' boundaries
+    //
+    {
+        std::vector< std::size_t > bounds;
+        shard_bounds(thread_idx, dwcm, bounds);
+        for(const std::size_t i : thread_idx) {
+            doc_chunks[i] = std::make_tuple(bounds[i], bounds[i+1]);
+        }
+    }
 
     if(jsonprefix.size() < 1) {
-        print_topics(vocabulary, twcm[0], n_topics);
+        if(sharded) {
+            std::vector< std::vector<std::size_t> > top;
+            count_vector_t ztot;
+            server_top_words(server, 8, top, ztot);
+            print_topics(vocabulary, top, ztot, n_topics);
+        }
+        else {
+            print_topics(vocabulary, twcm[0], n_topics);
+        }
 
         for(const std::size_t i : thread_idx) {
             const auto beg = std::get<0>(doc_chunks[i]);
@@ -152,6 +306,10 @@ int hpx_main(hpx::program_options::variables_map & vm) {
         json_topic_matrices(jsonprefix, dwcm, tdcm, twcm);
     }
 
+    if(sharded) {
+        release_topic_word_server(n_locales, locality_id, server);
+    }
+
     //for(const auto& tc : tdcm) {
     //    std::cout << tc << std::endl;
     //}
@@ -168,13 +326,37 @@ int main(int argc, char ** argv) {
         hpx::program_options::value<double>()->default_value(0.1),
         "alpha parameter")("beta,b",
         hpx::program_options::value<double>()->default_value(0.011),
-        "beta parameter")("num_topics,nt",
+        "beta parameter")("sampler,sp",
+        hpx::program_options::value<std::string>()->default_value("dense"),
+        "sampling kernel [dense|sparse|alias] (default: dense)")("seed,sd",
+        hpx::program_options::value<std::uint64_t>()->default_value(0),
+        "random number generator seed (default: 0)")("model,md",
+        hpx::program_options::value<std::string>()->default_value("replicated"),
+        "topic-word model [replicated|sharded], a copy per thread or sharded by word across localities (default: replicated)")("numa_report,nr",
+        "print the worker and NUMA node of each thread and of its state to stderr")("pipeline,pl",
+        hpx::program_options::value<std::size_t>()->default_value(0),
+        "reduce the topic-word differences in this many vocabulary slices while the next iteration samples, 0 waits for the reduction (default: 0)")("reduce,rd",
+        hpx::program_options::value<std::string>()->default_value("auto"),
+        "sum the localities' topic-word differences with one all_reduce or per node first, then in a ring across nodes [auto|flat|hierarchical] (default: auto)")("rebalance,rb",
+        hpx::program_options::value<double>()->default_value(0.0),
+        "move documents between threads when the slowest thread's sweep takes more than (1 + value) times the mean, 0 disables (default: 0)")("sync_every,se",
+        hpx::program_options::value<std::size_t>()->default_value(1),
+        "iterations each locality samples against its own copy of the topic-word model between merges (default: 1)")("sync_adaptive,sa",
+        hpx::program_options::value<double>()->default_value(0.0),
+        "adapt the iterations between merges, up to '--sync_every', to keep the fraction of tokens changing topic per iteration below this value, 0 disables (default: 0)")("checkpoint,ck",
+        hpx::program_options::value<std::string>(),
+        "file prefix each locality saves the topic of every token of its own to (prefix.locality-id), in the background, after the last iteration and every '--checkpoint_every' iterations")("checkpoint_every,ce",
+        hpx::program_options::value<std::size_t>()->default_value(0),
+        "iterations between checkpoints, 0 only saves after the last iteration (default: 0)")("resume,rs",
+        "continue training from the newest checkpoints at '--checkpoint' that every locality holds")("num_topics,nt",
         hpx::program_options::value<std::size_t>(),
         "number of topics")("vocab_list,vl",
         hpx::program_options::value<std::string>(),
         "file path containing the vocabulary list")("corpus_dir,cd",
         hpx::program_options::value<std::string>(),
-        "directory path containing the corpus to model")("json,js",
+        "directory path containing the corpus to model")("manifest,mf",
+        hpx::program_options::value<std::string>(),
+        "file listing the corpus files and their weights (bytes or tokens), read by locality 0 instead of listing the corpus directory; written there when missing")("json,js",
         hpx::program_options::value<std::string>(),
         "write matrices to json file with user provided prefix");
 
@@ -8,19 +8,33 @@
 #include <hpx/hpx.hpp>
 #include <hpx/hpx_init.hpp>
 #include <hpx/modules/collectives.hpp>
+#include <hpx/serialization/vector.hpp>
 #include <hpx/numeric.hpp>
 #include <hpx/algorithm.hpp>
 
+#include <iostream>
 #include <vector>
+#include <string>
 #include <numeric>
+#include <chrono>
 #include <algorithm>
+#include <functional>
 #include <cmath>
+#include <cstdlib>
 #include <cstdint>
 
 #include <blaze/Math.h>
 
 #include "distparldalib.hpp"
 #include "gibbs.hpp"
+#include "sparse_gibbs.hpp"
+#include "alias_gibbs.hpp"
+#include "column_reduce.hpp"
+#include "rebalance.hpp"
+#include "shard_placement.hpp"
+#include "delta_payload.hpp"
+#include "param_server.hpp"
+#include "hierarchical_reduce.hpp"
 #include "serialize.hpp"
 
 using namespace hpx::collectives;
@@ -29,77 +43,669 @@ using blaze::DynamicMatrix;
 using blaze::DynamicVector;
 using blaze::CompressedMatrix;
 
-void distpar_train_lda(const std::size_t n_locales, 
+// counter_rng streams are keyed by global token position; the shards of
+// this locality start after the tokens of localities [0, locality_id).
+// returns that offset
+//
+static std::uint64_t locality_rngs(const std::size_t n_locales,
                    const std::size_t locality_id,
                    const std::vector<std::size_t> & thread_idx,
-                   std::vector< CompressedMatrix<double> > const& dwcm,
-                   std::vector< DynamicMatrix<double> > & tdcm,
-                   std::vector< DynamicMatrix<double> > & twcm,
-                   std::vector< std::vector<std::size_t> > & tokens,
-                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta) {
-
-    const std::string all_reduce_direct_basename = "all_reduce_direct";
-    auto all_reduce_direct_client = create_communicator(
-        all_reduce_direct_basename.c_str(), num_sites_arg(n_locales), this_site_arg(locality_id)
+                   std::vector< token_topics > const& tokens,
+                   const std::uint64_t seed,
+                   std::vector< counter_rng > & rngs) {
+
+    std::uint64_t local_tokens = 0;
+    for(const std::size_t i : thread_idx) {
+        local_tokens += tokens[i].size();
+    }
+
+    const std::string all_gather_tokens_basename = "all_gather_tokens";
+    auto all_gather_tokens_client = create_communicator(
+        all_gather_tokens_basename.c_str(), num_sites_arg(n_locales), this_site_arg(locality_id)
     );
 
+    hpx::future< std::vector<std::uint64_t> > locality_tokens =
+        hpx::collectives::all_gather(all_gather_tokens_client, local_tokens);
+
+    const std::vector<std::uint64_t> counts = locality_tokens.get();
+    const std::uint64_t locality_offset = std::accumulate(std::begin(counts), std::begin(counts) + locality_id, std::uint64_t{0});
+
+    std::uint64_t offset = locality_offset;
+    for(const std::size_t i : thread_idx) {
+        rngs.emplace_back(seed, offset);
+        offset += tokens[i].size();
+    }
+
+    return locality_offset;
+}
+
+void distpar_train_lda(const std::size_t n_locales, 
+                   const std::size_t locality_id,
+                   const std::vector<std::size_t> & thread_idx,
+                   std::vector< sparse_count_matrix_t > & dwcm,
+                   std::vector< count_matrix_t > & tdcm,
+                   std::vector< count_matrix_t > & twcm,
+                   std::vector< token_topics > & tokens,
+                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+                   const sampler_type sampler,
+                   const std::uint64_t seed,
+                   const double rebalance,
+                   const std::size_t pipeline_slices,
+                   const reduce_algorithm reduction,
+                   const std::size_t sync_every,
+                   const double sync_tolerance,
+                   checkpoint_config const& checkpoint) {
+
+    // localities on the same node are combined before anything crosses
+    // the network when reduction calls for it (hierarchical_reduce.hpp)
+    //
+    const locality_topology topology = discover_topology(n_locales, locality_id);
+    if(locality_id == 0) {
+        std::cerr << "distparlda: " << describe_reduction(choose_reduce_algorithm(reduction, topology), topology) << std::endl;
+    }
+
     const std::size_t n_threads = thread_idx.size();
 
+    std::vector< counter_rng > rngs;
+    const std::uint64_t locality_offset = locality_rngs(n_locales, locality_id, thread_idx, tokens, seed, rngs);
+
     // build randomized topic-document-count-matrix and topic-word-count-matrix
+    // (or count the topics of the checkpoint being resumed); each shard has
+    // its own tdcm, twcm and rng stream so shards initialize in parallel
+    //
+    const bool resumed = (checkpoint.first_iteration > 0);
+    for_each_shard(thread_idx, [&dwcm, &tdcm, &twcm, &tokens, &rngs, n_topics, resumed](const std::size_t i) {
+        if(resumed) {
+            count_init(dwcm[i], tdcm[i], twcm[i], tokens[i]);
+        }
+        else {
+            random_init(dwcm[i], tdcm[i], twcm[i], tokens[i], rngs[i], n_topics);
+        }
+    });
+
+    checkpoint_writer checkpoints(checkpoint, seed, n_topics, shard_documents(thread_idx, dwcm));
+
+    std::vector< count_vector_t > ztot(n_threads);
+    std::vector< DynamicVector<double> > probs(n_threads);
+    std::vector< sparse_buckets > buckets(n_threads);
+    std::vector< alias_tables > tables(n_threads);
+
+    count_matrix_t twcm_base(twcm[0].rows(), twcm[0].columns());
+    count_matrix_t twcm_tmp(twcm[0].rows(), twcm[0].columns(), 0);
+
+    // sum the initial replicas in parallel over column blocks
+    // (column_reduce.hpp)
+    //
+    column_block_reduce(thread_idx, twcm, twcm_base, 4 * n_threads);
+
+    // accumulate and distribute the global topic-word-count-matrix
     //
     {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<std::size_t> dis(0, n_topics-1);
+        std::vector<std::size_t> all_words(twcm_base.columns());
+        std::iota(std::begin(all_words), std::end(all_words), 0);
 
-        for(const std::size_t i : thread_idx) {
-            const std::size_t n_docs = dwcm[i].rows();
+        delta_payload local;
+        encode_delta(twcm_base, all_words, local);
 
-            std::vector<std::size_t>::iterator token_itr = tokens[i].begin();
+        delta_reducer all_reduce_direct("all_reduce_direct", n_locales, locality_id, topology, reduction, 0, twcm_base.columns());
+        const delta_payload overall = all_reduce_direct.reduce(local).get();
 
-            for(std::size_t d = 0; d < n_docs; ++d) {
-                const auto dwcm_end = dwcm[i].end(d);
-                for(CompressedMatrix<double, blaze::rowMajor>::ConstIterator it = dwcm[i].begin(d); it != dwcm_end; ++it) {
-                    const std::size_t w = it->index();
-                    const std::size_t k_max = static_cast<std::size_t>(std::floor(it->value()));
-                    for(std::size_t k = 0; k < k_max; k++) {
-                        const std::size_t top = dis(gen);
-                        (*token_itr) = top;
-                        tdcm[i](top, d) += 1.0;
-                        twcm[i](top, w) += 1.0;
-                        ++token_itr;
+        twcm_base = 0;
+        for_each_delta(overall, [&twcm_base](const std::size_t w, const std::size_t t, const count_t v) {
+            twcm_base(t, w) = v;
+        });
+    }
+
+    column_block_broadcast(thread_idx, twcm_base, twcm, 4 * n_threads);
+
+    for_each_shard(thread_idx, [&ztot, &probs, n_topics](const std::size_t ti) {
+        ztot[ti].resize(n_topics);
+        probs[ti].resize(n_topics);
+        ztot[ti] = 0;
+        probs[ti] = 0.0;
+    });
+
+    double N = 0.0;
+    {
+        std::size_t Nsz = 0;
+        for(const auto& t : tokens) {
+            Nsz += t.size();
+        }
+
+        N = static_cast<double>(Nsz);
+    }
+
+    // words whose column each thread changed in the current sweep, and
+    // their union on this locality
+    //
+    std::vector< dirty_words > dirty(n_threads);
+    dirty_words changed;
+    for(const std::size_t ti : thread_idx) {
+        dirty[ti].resize(twcm_base.columns());
+    }
+    changed.resize(twcm_base.columns());
+
+    // topic totals of twcm_base; kept up to date from the reduced
+    // differences instead of summing twcm_base every iteration
+    //
+    count_vector_t ztot_base = topic_totals(twcm_base);
+
+    // columns of the reduced differences that any locality changed
+    //
+    dirty_words global_changed;
+    global_changed.resize(twcm_base.columns());
+
+    // the differences are reduced in n_slices vocabulary slices, slice sl
+    // holding words [slice_first[sl], slice_first[sl+1]), each with its
+    // own delta_reducer. sent[sl] is this locality's part of the reduction
+    // in_flight[sl]
+    //
+    const std::size_t n_slices = std::max<std::size_t>(pipeline_slices, 1);
+    const bool pipelined = (pipeline_slices > 0);
+
+    std::vector< std::size_t > slice_first(n_slices+1), slice_words;
+    for(std::size_t sl = 0; sl <= n_slices; ++sl) {
+        slice_first[sl] = (sl * twcm_base.columns()) / n_slices;
+    }
+
+    // reductions in flight refer to their reducer, so slice_reducers is
+    // never resized
+    //
+    std::vector< delta_reducer > slice_reducers;
+    slice_reducers.reserve(n_slices);
+    for(std::size_t sl = 0; sl < n_slices; ++sl) {
+        slice_reducers.emplace_back("all_reduce_delta_" + std::to_string(sl), n_locales, locality_id, topology, reduction, slice_first[sl], slice_first[sl+1]);
+    }
+
+    std::vector< delta_payload > sent(n_slices);
+    std::vector< hpx::future< delta_payload > > in_flight(n_slices);
+
+    // waits for the reductions in flight and adds what the other
+    // localities changed into the local base value and topic totals.
+    // returns the sum of the reduced differences' magnitudes, twice the
+    // number of tokens that changed topic on all localities
+    //
+    const auto apply_reduced = [&in_flight, &sent, &twcm_base, &ztot_base, &global_changed, n_slices]() {
+        std::uint64_t magnitude = 0;
+        for(std::size_t sl = 0; sl < n_slices; ++sl) {
+            const delta_payload reduced = in_flight[sl].get();
+
+            for_each_delta(reduced, [&twcm_base, &ztot_base, &global_changed, &magnitude](const std::size_t w, const std::size_t t, const count_t v) {
+                twcm_base(t, w) += v;
+                ztot_base[t] += v;
+                global_changed.mark(w);
+                magnitude += static_cast<std::uint64_t>(std::abs(v));
+            });
+
+            for_each_delta(sent[sl], [&twcm_base, &ztot_base, &global_changed](const std::size_t w, const std::size_t t, const count_t v) {
+                twcm_base(t, w) -= v;
+                ztot_base[t] -= v;
+                global_changed.mark(w);
+            });
+        }
+        return magnitude;
+    };
+
+    // the localities sweep sync_period times against their own model
+    // between reductions; unsent holds the words whose differences have
+    // accumulated in twcm_tmp since the last one. the last iteration
+    // always reduces so every locality ends with the same model
+    //
+    // with sync_tolerance above zero the period adapts: it halves while
+    // more than that fraction of all tokens changes topic per sweep and
+    // doubles, up to sync_every, while fewer do. every locality computes
+    // this from the same reduced differences, so they agree on it
+    //
+    dirty_words unsent;
+    unsent.resize(twcm_base.columns());
+
+    std::size_t sync_period = (sync_tolerance > 0.0) ? 1 : std::max<std::size_t>(sync_every, 1);
+    std::size_t unsynced = 0, reduced_sweeps = 0;
+
+    // checkpoints are taken at merges, so a resumed run starts right after
+    // one; an adaptive period carries on from the one saved with it
+    //
+    if(sync_tolerance > 0.0 && checkpoint.sync_period > 0) {
+        sync_period = std::min<std::size_t>(checkpoint.sync_period, std::max<std::size_t>(sync_every, 1));
+    }
+    bool reducing = false;
+
+    const auto adapt = [&sync_period, &reduced_sweeps, &ztot_base, locality_id, sync_every, sync_tolerance](const std::uint64_t magnitude) {
+        if(sync_tolerance <= 0.0 || reduced_sweeps == 0) {
+            return;
+        }
+
+        const double n_tokens = static_cast<double>(blaze::sum(ztot_base));
+        const double moved = (n_tokens > 0.0) ? (static_cast<double>(magnitude) / 2.0) / n_tokens / static_cast<double>(reduced_sweeps) : 0.0;
+
+        const std::size_t period = (moved > sync_tolerance) ?
+            std::max<std::size_t>(sync_period / 2, 1) : std::min<std::size_t>(sync_period * 2, std::max<std::size_t>(sync_every, 1));
+
+        if(period != sync_period && locality_id == 0) {
+            std::cerr << "distparlda: " << moved << " of the tokens moved per sweep, merging every " << period << " iterations" << std::endl;
+        }
+        sync_period = period;
+    };
+
+    // sampling time of each shard's last sweep; drives rebalance_shards
+    // when rebalance (the tolerated imbalance) is above zero. documents
+    // only move between the threads of this locality
+    //
+    std::vector<double> seconds(n_threads, 0.0);
+    bool rebalanced = false;
+    const std::string rebalance_prefix = "distparlda locality " + std::to_string(locality_id);
+
+    // set when a checkpoint came due since the last merge
+    //
+    bool checkpoint_due = false;
+
+    for(std::size_t i = checkpoint.first_iteration; i < iterations; ++i) {
+        std::fill(std::begin(ztot), std::end(ztot), ztot_base);
+
+        for(const std::size_t ti : thread_idx) {
+            rngs[ti].sweep(static_cast<std::uint32_t>(i));
+        }
+
+        for_each_shard(thread_idx, [&tokens, &dwcm, &tdcm, &twcm, &ztot, &probs, &buckets, &tables, &rngs, &dirty, &seconds, n_topics, alpha, beta, N, sampler](const std::size_t i) {
+            const auto start = std::chrono::steady_clock::now();
+
+            switch(sampler) {
+                case sampler_type::sparse:
+                    sparse_gibbs(dwcm[i], tdcm[i], twcm[i], tokens[i], ztot[i], buckets[i], rngs[i], n_topics, N, alpha, beta, &dirty[i]);
+                    break;
+                case sampler_type::alias:
+                    alias_gibbs(dwcm[i], tdcm[i], twcm[i], tokens[i], ztot[i], tables[i], rngs[i], n_topics, N, alpha, beta, model_sharing::replicated, &dirty[i]);
+                    break;
+                default:
+                    gibbs(dwcm[i], tdcm[i], twcm[i], tokens[i], ztot[i], probs[i], rngs[i], n_topics, N, alpha, beta, model_sharing::replicated, &dirty[i]);
+            }
+
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            seconds[i] = elapsed.count();
+        });
+
+        // fold the threads' differences into this locality's model right
+        // away, and into twcm_tmp until they are sent; a replica's clean
+        // columns still equal twcm_base and contribute nothing, so only
+        // changed columns are visited (twcm_tmp is zero outside of unsent)
+        //
+        for(const std::size_t ti : thread_idx) {
+            for(const std::size_t w : dirty[ti].words) {
+                changed.mark(w);
+                unsent.mark(w);
+            }
+        }
+
+        hpx::for_each(hpx::execution::par, std::begin(changed.words), std::end(changed.words), [&thread_idx, &twcm, &twcm_base, &twcm_tmp, &dirty, n_topics](const std::size_t w) {
+            count_t * base_w = twcm_base.data(w);
+            count_t * tmp_w = twcm_tmp.data(w);
+
+            for(std::size_t t = 0; t < n_topics; ++t) {
+                count_t d = 0;
+                for(const std::size_t ti : thread_idx) {
+                    if(dirty[ti].flags[w] != 0) {
+                        d += twcm[ti](t, w) - base_w[t];
                     }
                 }
+                base_w[t] += d;
+                tmp_w[t] += d;
+            }
+        });
+
+        for(std::size_t t = 0; t < n_topics; ++t) {
+            total_t dztot = 0;
+            for(const std::size_t ti : thread_idx) {
+                dztot += ztot[ti][t] - ztot_base[t];
+            }
+            ztot_base[t] += dztot;
+        }
+
+        ++unsynced;
+        const bool sync = (unsynced >= sync_period) || (i + 1 == iterations);
+
+        // pipelined, the reductions launched at the previous sync ran
+        // during this sweep; collect them before launching the next ones
+        //
+        if(reducing) {
+            adapt(apply_reduced());
+            reducing = false;
+        }
+
+        // combine global differences, one reduction per vocabulary slice;
+        // a slice's payload carries only its nonzero differences unless
+        // most of the slice's entries are nonzero (delta_payload.hpp)
+        //
+        if(sync) {
+            std::sort(std::begin(unsent.words), std::end(unsent.words));
+            for(std::size_t sl = 0; sl < n_slices; ++sl) {
+                const auto first = std::lower_bound(std::begin(unsent.words), std::end(unsent.words), slice_first[sl]);
+                const auto last = std::lower_bound(first, std::end(unsent.words), slice_first[sl+1]);
+                slice_words.assign(first, last);
+
+                encode_delta(twcm_tmp, slice_words, slice_first[sl], slice_first[sl+1], sent[sl]);
+                in_flight[sl] = slice_reducers[sl].reduce(sent[sl]);
+            }
+
+            for(const std::size_t w : unsent.words) {
+                std::fill_n(twcm_tmp.data(w), n_topics, 0);
+            }
+            unsent.clear();
+
+            reduced_sweeps = unsynced;
+            unsynced = 0;
+
+            if(pipelined) {
+                reducing = true;
+            }
+            else {
+                adapt(apply_reduced());
+            }
+        }
+
+        // update all threads
+        //
+        for_each_shard(thread_idx, [&twcm, &twcm_base, &global_changed, &changed, &dirty, &buckets, n_topics](const std::size_t ti) {
+            // columns other threads of this locality changed, and columns
+            // the reduction cancelled out, differ in some replicas
+            //
+            for(const std::size_t w : changed.words) {
+                std::copy_n(twcm_base.data(w), n_topics, twcm[ti].data(w));
+            }
+            for(const std::size_t w : global_changed.words) {
+                std::copy_n(twcm_base.data(w), n_topics, twcm[ti].data(w));
+            }
+            refresh_word_topics(buckets[ti], twcm[ti], changed.words);
+            refresh_word_topics(buckets[ti], twcm[ti], global_changed.words);
+            dirty[ti].clear();
+        });
+
+        changed.clear();
+        global_changed.clear();
+
+        if(rebalance > 0.0) {
+            const std::vector<std::size_t> moved = rebalance_shards(rebalance_prefix, i, iterations, thread_idx, seconds, rebalance, dwcm, tdcm, tokens, run_on_shards, rebalanced);
+            for(const std::size_t ti : moved) {
+                reset_word_topics(buckets[ti]);
+            }
+            if(!moved.empty()) {
+                rngs.clear();
+                std::uint64_t offset = locality_offset;
+                for(const std::size_t ti : thread_idx) {
+                    rngs.emplace_back(seed, offset);
+                    offset += tokens[ti].size();
+                }
             }
         }
+
+        // between merges a locality's model holds changes the others have
+        // not seen, so a checkpoint that comes due then waits for the next
+        // merge; every locality's model is then the sum of the saved
+        // topics (pipelined, once the merge is applied)
+        //
+        checkpoint_due = checkpoint_due || checkpoints.due(i, iterations);
+        if(checkpoint_due && sync) {
+            checkpoints.save(i, thread_idx, tokens, sync_period);
+            checkpoint_due = false;
+        }
     }
 
-    std::plus< DynamicMatrix<double> > adder{};
-    std::vector< DynamicVector<double> > ztot(n_threads);
-    std::vector< DynamicVector<double> > probs(n_threads);
-    std::vector< drand > drands(n_threads);
+    // pipelined, the last sweep's reductions are still in flight
+    //
+    if(reducing) {
+        apply_reduced();
 
-    DynamicMatrix<double> twcm_base(twcm[0].rows(), twcm[0].columns(), 0.0);
-    DynamicMatrix<double> twcm_tmp(twcm[0].rows(), twcm[0].columns(), 0.0);
+        for_each_shard(thread_idx, [&twcm, &twcm_base, &global_changed, n_topics](const std::size_t ti) {
+            for(const std::size_t w : global_changed.words) {
+                std::copy_n(twcm_base.data(w), n_topics, twcm[ti].data(w));
+            }
+        });
+    }
+}
 
-    twcm_base = hpx::reduce(std::begin(twcm), std::end(twcm), twcm_base, adder);
+bool resume_locality_checkpoint(const std::size_t n_locales, const std::size_t locality_id, std::string const& path,
+                   const std::uint64_t seed, const std::size_t n_topics,
+                   const std::vector<std::size_t> & thread_idx,
+                   std::vector< sparse_count_matrix_t > const& dwcm,
+                   std::vector< token_topics > & tokens,
+                   checkpoint_config & config) {
 
-    // accumulate and distribute the global topic-word-count-matrix
+    training_checkpoint current, prev;
+    const bool have_current = read_checkpoint(path, current);
+    const bool have_prev = read_checkpoint(path + ".prev", prev);
+
+    // a locality stopped while writing may be a checkpoint behind the
+    // others; the newest iteration all of them hold is resumed
+    //
+    std::vector<std::uint64_t> held;
+    if(have_current) {
+        held.push_back(current.iterations);
+    }
+    if(have_prev) {
+        held.push_back(prev.iterations);
+    }
+
+    const std::string all_gather_checkpoints_basename = "all_gather_checkpoints";
+    auto all_gather_checkpoints_client = create_communicator(
+        all_gather_checkpoints_basename.c_str(), num_sites_arg(n_locales), this_site_arg(locality_id)
+    );
+
+    const std::vector< std::vector<std::uint64_t> > all_held =
+        hpx::collectives::all_gather(all_gather_checkpoints_client, held).get();
+
+    bool found = false;
+    std::uint64_t newest = 0;
+    for(const std::uint64_t it : all_held[0]) {
+        const bool everywhere = std::all_of(std::begin(all_held), std::end(all_held), [it](std::vector<std::uint64_t> const& h) {
+            return std::find(std::begin(h), std::end(h), it) != std::end(h);
+        });
+
+        if(everywhere && (!found || it > newest)) {
+            newest = it;
+            found = true;
+        }
+    }
+
+    if(!found) {
+        return false;
+    }
+
+    training_checkpoint const& checkpoint = (have_current && current.iterations == newest) ? current : prev;
+    const bool restored = (checkpoint.seed == seed) &&
+        restore_checkpoint(checkpoint, n_topics, shard_documents(thread_idx, dwcm), thread_idx, tokens);
+
+    // every locality resumes or none does
+    //
+    const std::string all_reduce_restored_basename = "all_reduce_restored";
+    auto all_reduce_restored_client = create_communicator(
+        all_reduce_restored_basename.c_str(), num_sites_arg(n_locales), this_site_arg(locality_id)
+    );
+
+    const std::uint64_t failed = hpx::collectives::all_reduce(all_reduce_restored_client,
+        std::uint64_t{restored ? 0U : 1U}, std::plus<std::uint64_t>{}).get();
+
+    config.first_iteration = static_cast<std::size_t>(newest);
+    config.sync_period = static_cast<std::size_t>(checkpoint.sync_period);
+    return failed == 0;
+}
+
+void sharded_train_lda(const std::size_t n_locales,
+                   const std::size_t locality_id,
+                   const std::vector<std::size_t> & thread_idx,
+                   std::vector< sparse_count_matrix_t > const& dwcm,
+                   std::vector< count_matrix_t > & tdcm,
+                   std::vector< token_topics > & tokens,
+                   topic_word_server const& server,
+                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+                   const sampler_type sampler,
+                   const std::uint64_t seed) {
+
+    // sparse_gibbs keeps a per-thread index of each word's topics that
+    // other threads' adds would leave stale (sparse_gibbs.hpp); every
+    // locality is given the same sampler, so all of them return here
+    //
+    if(sampler == sampler_type::sparse) {
+        std::cerr << "distparlda: the sharded model does not support the sparse sampler" << std::endl;
+        return;
+    }
+
+    const std::size_t n_threads = thread_idx.size();
+    const std::size_t n_words = server.n_words;
+
+    std::vector< counter_rng > rngs;
+    locality_rngs(n_locales, locality_id, thread_idx, tokens, seed, rngs);
+
+    // the words this locality's documents use, in increasing order; word
+    // local_words[l] is column l of the locality's part of the model
     //
+    std::vector< std::size_t > local_words;
     {
-        hpx::future< DynamicMatrix<double> > overall_result =
-            hpx::collectives::all_reduce(all_reduce_direct_client, twcm_base, adder);
+        dirty_words used;
+        used.resize(n_words);
+        for(const std::size_t ti : thread_idx) {
+            for(std::size_t d = 0; d < dwcm[ti].rows(); ++d) {
+                for(auto it = dwcm[ti].begin(d); it != dwcm[ti].end(d); ++it) {
+                    used.mark(it->index());
+                }
+            }
+        }
 
-        twcm_base = overall_result.get();
+        local_words = std::move(used.words);
+        std::sort(std::begin(local_words), std::end(local_words));
     }
 
-    for(const std::size_t ti : thread_idx) {
-        twcm[ti] = twcm_base;
+    const std::size_t n_local = local_words.size();
+
+    // the shards' documents over local columns; local_words is increasing
+    // so every row keeps its order and every token its position
+    //
+    std::vector< sparse_count_matrix_t > local_dwcm(n_threads);
+    for_each_shard(thread_idx, [&dwcm, &local_dwcm, &local_words, n_local](const std::size_t ti) {
+        const std::size_t n_docs = dwcm[ti].rows();
+        local_dwcm[ti].resize(n_docs, n_local, false);
+        local_dwcm[ti].reserve(dwcm[ti].nonZeros());
+
+        for(std::size_t d = 0; d < n_docs; ++d) {
+            for(auto it = dwcm[ti].begin(d); it != dwcm[ti].end(d); ++it) {
+                const std::size_t l = static_cast<std::size_t>(std::lower_bound(std::begin(local_words), std::end(local_words), it->index()) - std::begin(local_words));
+                local_dwcm[ti].append(d, l, it->value());
+            }
+            local_dwcm[ti].finalize(d);
+        }
+    });
+
+    // shard_words[o] are the local words held by locality o's shard and
+    // shard_columns[o] their local columns
+    //
+    std::vector< std::vector<std::uint64_t> > shard_words(n_locales);
+    std::vector< std::vector<std::size_t> > shard_columns(n_locales);
+    for(std::size_t l = 0; l < n_local; ++l) {
+        const std::size_t o = shard_of(local_words[l], n_locales);
+        shard_words[o].push_back(local_words[l]);
+        shard_columns[o].push_back(l);
+    }
+
+    // twcm is the model's local columns, sampled by all of the locality's
+    // threads (model_sharing::shared)
+    //
+    count_matrix_t twcm(n_topics, n_local, 0);
+    count_vector_t ztot_base(n_topics, 0);
+
+    for_each_shard(thread_idx, [&local_dwcm, &tdcm, &twcm, &tokens, &rngs, n_topics](const std::size_t i) {
+        random_init(local_dwcm[i], tdcm[i], twcm, tokens[i], rngs[i], n_topics, model_sharing::shared);
+    });
+
+    const std::string all_reduce_pushed_basename = "all_reduce_pushed";
+    auto all_reduce_pushed_client = create_communicator(
+        all_reduce_pushed_basename.c_str(), num_sites_arg(n_locales), this_site_arg(locality_id)
+    );
+
+    std::vector< std::vector<std::size_t> > changed_columns(n_locales);
+    std::vector< std::vector<std::uint64_t> > changed_words(n_locales);
+    std::vector< delta_payload > deltas(n_locales);
+
+    // pushes delta, whose column j is the change of local column
+    // changed[j] since the last push, to the shards holding them as the
+    // given round, waits until every locality has pushed, then pulls the
+    // local columns any locality pushed to in that round and the topic
+    // totals. the other local columns are unchanged since the last pull
+    //
+    const auto synchronize = [&](const std::uint64_t round, count_matrix_t const& delta, std::vector<std::size_t> const& changed) {
+        for(std::size_t o = 0; o < n_locales; ++o) {
+            changed_columns[o].clear();
+            changed_words[o].clear();
+        }
+
+        for(std::size_t j = 0; j < changed.size(); ++j) {
+            const std::size_t w = local_words[changed[j]];
+            const std::size_t o = shard_of(w, n_locales);
+            changed_columns[o].push_back(j);
+            changed_words[o].push_back(w);
+        }
+
+        std::vector< hpx::future<void> > pushes;
+        std::uint64_t pushed = 0;
+        for(std::size_t o = 0; o < n_locales; ++o) {
+            if(changed_columns[o].empty()) {
+                continue;
+            }
+
+            encode_columns(delta, changed_columns[o], deltas[o]);
+            pushed += deltas[o].nonzeros;
+            pushes.push_back(hpx::async<topic_word_shard::push_action>(server.shards[o], changed_words[o], deltas[o], round));
+        }
+
+        for(auto & p : pushes) {
+            p.get();
+        }
+
+        // every locality's pushes have been applied once all of them
+        // arrive here
+        //
+        hpx::collectives::all_reduce(all_reduce_pushed_client, pushed, std::plus<std::uint64_t>{}).get();
+
+        std::vector< hpx::future< word_counts > > pulls(n_locales);
+        for(std::size_t o = 0; o < n_locales; ++o) {
+            if(!shard_words[o].empty()) {
+                pulls[o] = hpx::async<topic_word_shard::pull_action>(server.shards[o], shard_words[o], round);
+            }
+        }
+
+        server_totals(server, ztot_base);
+
+        for(std::size_t o = 0; o < n_locales; ++o) {
+            if(shard_words[o].empty()) {
+                continue;
+            }
+
+            const word_counts columns = pulls[o].get();
+            const std::size_t n_columns = columns.words.size();
+            for(std::size_t j = 0; j < n_columns; ++j) {
+                const std::size_t l = static_cast<std::size_t>(std::lower_bound(std::begin(local_words), std::end(local_words), columns.words[j]) - std::begin(local_words));
+                std::copy_n(columns.counts.data() + j * n_topics, n_topics, twcm.data(l));
+            }
+        }
+    };
+
+    // round 0 pushes every column's initial counts and pulls every column
+    //
+    {
+        std::vector<std::size_t> all_columns(n_local);
+        std::iota(std::begin(all_columns), std::end(all_columns), 0);
+        synchronize(0, twcm, all_columns);
+    }
+
+    std::vector< count_vector_t > ztot(n_threads);
+    std::vector< DynamicVector<double> > probs(n_threads);
+    std::vector< alias_tables > tables(n_threads);
+    std::vector< dirty_words > dirty(n_threads);
+
+    for_each_shard(thread_idx, [&ztot, &probs, &dirty, n_topics, n_local](const std::size_t ti) {
         ztot[ti].resize(n_topics);
         probs[ti].resize(n_topics);
-        ztot[ti] = 0.0;
+        ztot[ti] = 0;
         probs[ti] = 0.0;
-    }
+        dirty[ti].resize(n_local);
+    });
 
     double N = 0.0;
     {
@@ -111,34 +717,74 @@ void distpar_train_lda(const std::size_t n_locales,
         N = static_cast<double>(Nsz);
     }
 
+    // a sweep's changes are worked out from the token topics before it
+    // (before[i]): delta holds one column per local column the sweep
+    // changed, at slot[l]
+    //
+    std::vector< token_topics > before(n_threads);
+    std::vector< std::size_t > slot(n_local);
+    count_matrix_t delta;
+
+    dirty_words changed;
+    changed.resize(n_local);
+
     for(std::size_t i = 0; i < iterations; ++i) {
-        ztot[0] = blaze::sum<blaze::rowwise>(twcm_base);
-        std::fill(std::begin(ztot), std::end(ztot), ztot[0]);
+        std::fill(std::begin(ztot), std::end(ztot), ztot_base);
+
+        for(const std::size_t ti : thread_idx) {
+            rngs[ti].sweep(static_cast<std::uint32_t>(i));
+        }
 
-        hpx::for_each(hpx::execution::par, std::begin(thread_idx), std::end(thread_idx), [&tokens, &dwcm, &tdcm, &twcm, &twcm_base, &ztot, &probs, &drands, n_topics, alpha, beta, N](const std::size_t i) {
-            gibbs(dwcm[i], tdcm[i], twcm[i], tokens[i], ztot[i], probs[i], drands[i], n_topics, N, alpha, beta);
-            twcm[i] -= twcm_base;
+        for_each_shard(thread_idx, [&tokens, &before, &local_dwcm, &tdcm, &twcm, &ztot, &probs, &tables, &rngs, &dirty, n_topics, alpha, beta, N, sampler](const std::size_t i) {
+            before[i] = tokens[i];
+
+            switch(sampler) {
+                case sampler_type::alias:
+                    alias_gibbs(local_dwcm[i], tdcm[i], twcm, tokens[i], ztot[i], tables[i], rngs[i], n_topics, N, alpha, beta, model_sharing::shared, &dirty[i]);
+                    break;
+                default:
+                    gibbs(local_dwcm[i], tdcm[i], twcm, tokens[i], ztot[i], probs[i], rngs[i], n_topics, N, alpha, beta, model_sharing::shared, &dirty[i]);
+            }
         });
 
-        // store local differences
-        //
-        twcm_tmp = hpx::reduce(std::begin(twcm), std::end(twcm), twcm_tmp, adder);
+        for(const std::size_t ti : thread_idx) {
+            for(const std::size_t l : dirty[ti].words) {
+                changed.mark(l);
+            }
+            dirty[ti].clear();
+        }
 
-        // combine global differences
-        //
-        hpx::future< DynamicMatrix<double> > overall_result =
-            hpx::collectives::all_reduce(all_reduce_direct_client, twcm_tmp, adder);
+        std::sort(std::begin(changed.words), std::end(changed.words));
 
-        twcm_tmp = overall_result.get();
+        const std::size_t n_changed = changed.words.size();
+        for(std::size_t j = 0; j < n_changed; ++j) {
+            slot[changed.words[j]] = j;
+        }
 
-        // add totall differences into local base value
-        //
-        twcm_base += twcm_tmp;
+        delta.resize(n_topics, n_changed, false);
+        delta = 0;
 
-        // update all threads
-        //
-        std::fill(std::begin(twcm), std::end(twcm), twcm_base);
+        for_each_shard(thread_idx, [&tokens, &before, &local_dwcm, &slot, &delta](const std::size_t ti) {
+            const std::size_t n_docs = local_dwcm[ti].rows();
+            std::size_t pos = 0;
+            for(std::size_t d = 0; d < n_docs; ++d) {
+                const auto dwcm_end = local_dwcm[ti].end(d);
+                for(sparse_count_matrix_t::ConstIterator it = local_dwcm[ti].begin(d); it != dwcm_end; ++it) {
+                    const std::size_t k_max = static_cast<std::size_t>(it->value());
+                    for(std::size_t k = 0; k < k_max; ++k, ++pos) {
+                        const std::size_t t = before[ti].get(pos);
+                        const std::size_t nt = tokens[ti].get(pos);
+                        if(t != nt) {
+                            count_t * delta_l = delta.data(slot[it->index()]);
+                            add_count<true>(delta_l[t], -1);
+                            add_count<true>(delta_l[nt], 1);
+                        }
+                    }
+                }
+            }
+        });
 
-        twcm_tmp = 0.0;
+        synchronize(i + 1, delta, changed.words);
+        changed.clear();
     }
 }
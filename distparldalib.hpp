@@ -7,20 +7,100 @@
 #pragma once
 #ifndef __DISTPARLDALIB_HPP__
 #include <vector>
+#include <string>
 #include <cstdint>
 
 #include <blaze/Math.h>
 
+#include "gibbs.hpp"
+#include "counts.hpp"
+#include "param_server.hpp"
+#include "hierarchical_reduce.hpp"
+#include "checkpoint.hpp"
+
 using blaze::DynamicMatrix;
 using blaze::DynamicVector;
 using blaze::CompressedMatrix;
 
+// trains this locality's shards, merging the topic-word counts of all
+// localities after every sweep. rebalance works as in par_train_lda and
+// moves documents between the threads of a locality only
+//
+// with pipeline_slices above zero the merge is split into that many
+// vocabulary slices whose reductions run while the next sweep samples;
+// a sweep then sees the other localities' changes one iteration late
+// (its own locality's are never late)
+//
+// reduction picks how the localities' counts are summed
+// (hierarchical_reduce.hpp); the choice is logged to std::cerr by
+// locality 0
+//
+// sync_every above one lets each locality run that many sweeps against
+// its own copy of the model between merges (AD-LDA); the threads of a
+// locality still share their changes after every sweep. sync_tolerance
+// above zero makes the period adaptive: it starts at one and grows, up to
+// sync_every, while fewer than that fraction of all tokens change topic
+// per sweep, and shrinks again when more do. changes are logged by
+// locality 0
+//
+// checkpoint saves this locality's token topics (checkpoint.hpp); every
+// locality passes the same every, first_iteration and sync_period.
+// checkpoints are taken at merges (a checkpoint that comes due between
+// merges waits for the next one) along with the merge period, so a
+// resumed run keeps the uninterrupted run's merge points. a run resumed
+// while reductions were pipelined starts from the merged model, which the
+// uninterrupted run only reached an iteration later, so it does not
+// retrace that run exactly
+//
 void distpar_train_lda(const std::size_t n_locales, 
                    const std::size_t locality_id,
                    const std::vector<std::size_t> & thread_idx,
-                   std::vector< CompressedMatrix<double> > const& dwcm,
-                   std::vector< DynamicMatrix<double> > & tdcm,
-                   std::vector< DynamicMatrix<double> > & twcm,
-                   std::vector< std::vector<std::size_t> > & tokens,
-                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta);
+                   std::vector< sparse_count_matrix_t > & dwcm,
+                   std::vector< count_matrix_t > & tdcm,
+                   std::vector< count_matrix_t > & twcm,
+                   std::vector< token_topics > & tokens,
+                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+                   const sampler_type sampler = sampler_type::dense,
+                   const std::uint64_t seed = 0,
+                   const double rebalance = 0.0,
+                   const std::size_t pipeline_slices = 0,
+                   const reduce_algorithm reduction = reduce_algorithm::automatic,
+                   const std::size_t sync_every = 1,
+                   const double sync_tolerance = 0.0,
+                   checkpoint_config const& checkpoint = checkpoint_config{});
+
+// restores the topics of this locality's tokens from its checkpoint at
+// path (or path.prev) of the newest iteration every locality has a
+// checkpoint of, and sets config's first_iteration and sync_period from
+// it. false on every locality
+// when some locality has no such checkpoint or its checkpoint was taken
+// with another corpus, seed or number of topics. called on every locality
+//
+bool resume_locality_checkpoint(const std::size_t n_locales, const std::size_t locality_id, std::string const& path,
+                   const std::uint64_t seed, const std::size_t n_topics,
+                   const std::vector<std::size_t> & thread_idx,
+                   std::vector< sparse_count_matrix_t > const& dwcm,
+                   std::vector< token_topics > & tokens,
+                   checkpoint_config & config);
+
+// trains this locality's shards against a topic-word model sharded by word
+// across the localities (param_server.hpp) instead of a full K x V copy
+// per locality and thread. the locality holds only the columns of the
+// words its documents use, sampled by all of its threads with atomic
+// adds (model_sharing::shared); after every sweep it pushes the
+// differences of the columns it changed to the shards holding them and
+// pulls back those of its columns any locality changed. every locality
+// calls it with the same server.
+// sampler_type::sparse is not supported
+//
+void sharded_train_lda(const std::size_t n_locales,
+                   const std::size_t locality_id,
+                   const std::vector<std::size_t> & thread_idx,
+                   std::vector< sparse_count_matrix_t > const& dwcm,
+                   std::vector< count_matrix_t > & tdcm,
+                   std::vector< token_topics > & tokens,
+                   topic_word_server const& server,
+                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+                   const sampler_type sampler = sampler_type::dense,
+                   const std::uint64_t seed = 0);
 #endif
@@ -9,6 +9,7 @@
 #include <vector>
 #include <unordered_map>
 #include <algorithm>
+#include <numeric>
 #include <cassert>
 
 #include <unicode/unistr.h>
@@ -39,6 +40,13 @@ std::size_t path_to_vector(fs::path const& p, std::vector<fs::path> & paths) {
     return paths.size();
 }
 
+void path_sizes(std::vector<fs::path> const& paths, std::vector<std::size_t> & sizes) {
+    sizes.resize(paths.size());
+    std::transform(std::begin(paths), std::end(paths), std::begin(sizes), [](fs::path const& p) {
+        return static_cast<std::size_t>(fs::file_size(p));
+    });
+}
+
 void read_content(fs::path const& p, std::vector<UnicodeString> & fcontent) {
     std::ifstream istrm(p, std::ios::in | std::ios::binary);
     UnicodeString rd;
@@ -80,7 +88,7 @@ static void read_file_content(std::vector<fs::path>::iterator & beg, std::vector
 //
 // https://github.com/jpakkane/cppunicode/blob/main/cppunicode.cpp
 //
-void inverted_index_to_matrix(std::unordered_map<std::string, std::size_t> const& voc, inverted_index_t const& idx, const std::size_t ndocs, CompressedMatrix<double> & mat, const bool debug) {
+void inverted_index_to_matrix(std::unordered_map<std::string, std::size_t> const& voc, inverted_index_t const& idx, const std::size_t ndocs, sparse_count_matrix_t & mat, const bool debug) {
     const std::size_t nvoc = voc.size();
     mat.resize(nvoc, ndocs);
     const auto voc_end = voc.end();
@@ -94,7 +102,7 @@ void inverted_index_to_matrix(std::unordered_map<std::string, std::size_t> const
             mat.reserve(vocidx, docsz);
 
             for(const auto d : w.second) {
-                mat.append(vocidx, d.first, d.second);
+                mat.append(vocidx, d.first, static_cast<count_t>(d.second));
             }
 
             mat.finalize(vocidx);
@@ -202,10 +210,77 @@ std::size_t document_path_to_inverted_index(std::vector<fs::path>::iterator & be
 }
 
 
-void matrix_to_vector(CompressedMatrix<double> const& mat, std::vector<std::size_t> & tokens) {
-    const std::size_t wcount = static_cast<std::size_t>(std::floor(blaze::sum(mat)));
-    tokens.resize(wcount);
-    std::fill(std::begin(tokens), std::end(tokens), 0);
+void matrix_to_vector(sparse_count_matrix_t const& mat, token_topics & tokens, const std::size_t n_topics) {
+    // summed in std::size_t; blaze::sum would accumulate in count_t
+    //
+    std::size_t wcount = 0;
+    for(std::size_t r = 0; r < mat.rows(); ++r) {
+        const auto mat_end = mat.end(r);
+        for(sparse_count_matrix_t::ConstIterator it = mat.begin(r); it != mat_end; ++it) {
+            wcount += static_cast<std::size_t>(it->value());
+        }
+    }
+
+    tokens.resize(wcount, n_topics);
+}
+
+void balanced_partition(std::vector<std::size_t> const& weights, std::vector<double> const& shares, std::vector<std::size_t> & bounds) {
+    const std::size_t n_items = weights.size();
+    const std::size_t n_parts = shares.size();
+
+    // prefix[i] is the weight of items [0, i)
+    //
+    std::vector<std::size_t> prefix(n_items+1, 0);
+    std::partial_sum(std::begin(weights), std::end(weights), std::begin(prefix)+1);
+    const double total = static_cast<double>(prefix[n_items]);
+
+    bounds.assign(n_parts+1, n_items);
+    bounds[0] = 0;
+
+    // part p ends at the prefix closest to the summed shares of parts
+    // [0, p] of the total weight; bounds never move backwards, so a heavy
+    // item leaves the parts after it lighter (or empty) rather than
+    // splitting it
+    //
+    double share = 0.0;
+    for(std::size_t p = 1; p < n_parts; ++p) {
+        share += shares[p-1];
+        const double target = total * share;
+        std::size_t b = static_cast<std::size_t>(std::lower_bound(std::begin(prefix), std::end(prefix), target,
+            [](const std::size_t x, const double t) { return static_cast<double>(x) < t; }) - std::begin(prefix));
+
+        b = std::min(b, n_items);
+        if(b > 0 && (target - static_cast<double>(prefix[b-1])) < (static_cast<double>(prefix[b]) - target)) {
+            --b;
+        }
+
+        bounds[p] = std::min(std::max(b, bounds[p-1]), n_items);
+    }
+}
+
+void balanced_partition(std::vector<std::size_t> const& weights, const std::size_t n_parts, std::vector<std::size_t> & bounds) {
+    const std::vector<double> shares(n_parts, 1.0 / static_cast<double>(n_parts));
+    balanced_partition(weights, shares, bounds);
+}
+
+void copy_rows(sparse_count_matrix_t const& mat, const std::size_t first, const std::size_t last, sparse_count_matrix_t & part) {
+    const std::size_t n_rows = last - first;
+
+    std::size_t nnz = 0;
+    for(std::size_t r = 0; r < n_rows; ++r) {
+        nnz += mat.nonZeros(first + r);
+    }
+
+    part.resize(n_rows, mat.columns(), false);
+    part.reserve(nnz);
+
+    for(std::size_t r = 0; r < n_rows; ++r) {
+        const auto mat_end = mat.end(first + r);
+        for(sparse_count_matrix_t::ConstIterator it = mat.begin(first + r); it != mat_end; ++it) {
+            part.append(r, it->index(), it->value());
+        }
+        part.finalize(r);
+    }
 }
 
 std::size_t load_wordlist(fs::path const& pth, std::unordered_map<std::string, std::size_t> & vocab) {
@@ -18,6 +18,8 @@
 #include <unicode/unistr.h>
 #include <blaze/Math.h>
 #include "inverted_index.hpp"
+#include "counts.hpp"
+#include "token_topics.hpp"
 
 namespace fs = std::experimental::filesystem;
 
@@ -38,9 +40,32 @@ std::size_t document_path_to_inverted_index(std::vector<fs::path>::iterator & be
 
 std::size_t document_path_to_inverted_index(std::vector<fs::path>::iterator & beg, std::vector<fs::path>::iterator & end, UnicodeString & regexp, inverted_index_t & ii);
 
-void inverted_index_to_matrix(std::unordered_map<std::string, std::size_t> const & vocab, inverted_index_t const& idx, const std::size_t doc_count, CompressedMatrix<double> & mat, const bool debug=false);
+void inverted_index_to_matrix(std::unordered_map<std::string, std::size_t> const & vocab, inverted_index_t const& idx, const std::size_t doc_count, sparse_count_matrix_t & mat, const bool debug=false);
 
-void matrix_to_vector(CompressedMatrix<double> const& mat, std::vector<std::size_t> & tokens);
+// sizes tokens to the number of tokens in mat, packed for n_topics topics
+//
+void matrix_to_vector(sparse_count_matrix_t const& mat, token_topics & tokens, const std::size_t n_topics);
+
+// file size in bytes of each path; a proxy for token counts before the
+// documents are indexed
+//
+void path_sizes(std::vector<fs::path> const& paths, std::vector<std::size_t> & sizes);
+
+// splits items [0, weights.size()) into n_parts contiguous ranges of about
+// equal total weight; part p is [bounds[p], bounds[p+1]). used to shard
+// documents by token count (or file size) instead of by document count
+//
+void balanced_partition(std::vector<std::size_t> const& weights, const std::size_t n_parts, std::vector<std::size_t> & bounds);
+
+// as above, with part p getting about shares[p] of the total weight
+// (shares sum to 1)
+//
+void balanced_partition(std::vector<std::size_t> const& weights, std::vector<double> const& shares, std::vector<std::size_t> & bounds);
+
+// copies rows [first, last) of mat into part; run by the thread that
+// will own part so its memory is first touched there
+//
+void copy_rows(sparse_count_matrix_t const& mat, const std::size_t first, const std::size_t last, sparse_count_matrix_t & part);
 
 std::size_t load_wordlist(fs::path const& pth, std::unordered_map<std::string, std::size_t> & vocab);
 
@@ -5,8 +5,10 @@
 //  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 //
 #include "gibbs.hpp"
+#include "topic_draw.hpp"
 
 #include <vector>
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 
@@ -16,64 +18,412 @@ using blaze::DynamicMatrix;
 using blaze::DynamicVector;
 using blaze::CompressedMatrix;
 
-void gibbs(
-    CompressedMatrix<double> const& dwcm,
-    DynamicMatrix<double> & tdcm,
-    DynamicMatrix<double> & twcm,
-    std::vector<std::size_t> & tokens, DynamicVector<double> & ztot,
+bool sampler_from_string(std::string const& name, sampler_type & sampler) {
+    if(name == "dense") {
+        sampler = sampler_type::dense;
+        return true;
+    }
+    else if(name == "sparse") {
+        sampler = sampler_type::sparse;
+        return true;
+    }
+    else if(name == "alias") {
+        sampler = sampler_type::alias;
+        return true;
+    }
+
+    return false;
+}
+
+bool sweep_order_from_string(std::string const& name, sweep_order & order) {
+    if(name == "document") {
+        order = sweep_order::document;
+        return true;
+    }
+    else if(name == "word") {
+        order = sweep_order::word;
+        return true;
+    }
+
+    return false;
+}
+
+bool model_sharing_from_string(std::string const& name, model_sharing & sharing) {
+    if(name == "replicated") {
+        sharing = model_sharing::replicated;
+        return true;
+    }
+    else if(name == "shared") {
+        sharing = model_sharing::shared;
+        return true;
+    }
+
+    return false;
+}
+
+void build_word_order(sparse_count_matrix_t const& dwcm, const std::size_t n_words, word_order & order) {
+    const std::size_t n_docs = dwcm.rows();
+
+    // counting sort of the tokens by word
+    //
+    order.offsets.assign(n_words+1, 0);
+    for(std::size_t d = 0; d < n_docs; ++d) {
+        const auto dwcm_end = dwcm.end(d);
+        for(sparse_count_matrix_t::ConstIterator it = dwcm.begin(d); it != dwcm_end; ++it) {
+            order.offsets[it->index()+1] += static_cast<std::size_t>(it->value());
+        }
+    }
+
+    for(std::size_t w = 0; w < n_words; ++w) {
+        order.offsets[w+1] += order.offsets[w];
+    }
+
+    order.docs.resize(order.offsets[n_words]);
+    order.positions.resize(order.offsets[n_words]);
+
+    std::vector<std::size_t> next(order.offsets.begin(), order.offsets.end()-1);
+    std::size_t pos = 0;
+
+    for(std::size_t d = 0; d < n_docs; ++d) {
+        const auto dwcm_end = dwcm.end(d);
+        for(sparse_count_matrix_t::ConstIterator it = dwcm.begin(d); it != dwcm_end; ++it) {
+            const std::size_t w = it->index();
+            const std::size_t k_max = static_cast<std::size_t>(it->value());
+            for(std::size_t k = 0; k < k_max; k++) {
+                const std::size_t e = next[w]++;
+                order.docs[e] = static_cast<std::uint32_t>(d);
+                order.positions[e] = pos++;
+            }
+        }
+    }
+}
+
+std::size_t doc_tokens(sparse_count_matrix_t const& dwcm, const std::size_t d) {
+    std::size_t n_d = 0;
+    const auto dwcm_end = dwcm.end(d);
+    for(sparse_count_matrix_t::ConstIterator it = dwcm.begin(d); it != dwcm_end; ++it) {
+        n_d += static_cast<std::size_t>(it->value());
+    }
+    return n_d;
+}
+
+std::size_t shard_documents(std::vector<std::size_t> const& thread_idx, std::vector< sparse_count_matrix_t > const& dwcm) {
+    std::size_t n_docs = 0;
+    for(const std::size_t ti : thread_idx) {
+        n_docs += dwcm[ti].rows();
+    }
+    return n_docs;
+}
+
+void random_init(
+    sparse_count_matrix_t const& dwcm,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens,
+    counter_rng & rng,
+    const std::size_t n_topics,
+    const model_sharing sharing) {
+
+    const std::size_t n_docs = dwcm.rows();
+    const double topics = static_cast<double>(n_topics);
+
+    // tokens sized for fewer topics (matrix_to_vector) are widened
+    //
+    if(!tokens.holds(n_topics)) {
+        tokens.resize(tokens.size(), n_topics);
+    }
+
+    rng.sweep(counter_rng::init_sweep);
+
+    std::size_t pos = 0;
+
+    for(std::size_t d = 0; d < n_docs; ++d) {
+        rng.prefetch(pos, doc_tokens(dwcm, d));
+
+        const auto dwcm_end = dwcm.end(d);
+        for(sparse_count_matrix_t::ConstIterator it = dwcm.begin(d); it != dwcm_end; ++it) {
+            const std::size_t w = it->index();
+            const std::size_t k_max = static_cast<std::size_t>(it->value());
+            for(std::size_t k = 0; k < k_max; k++) {
+                rng.seek(pos);
+                const std::size_t top = std::min(static_cast<std::size_t>(rng() * topics), n_topics-1);
+                tokens.set(pos, top);
+                tdcm(top, d) += 1;
+                add_count(twcm(top, w), 1, sharing == model_sharing::shared);
+                ++pos;
+            }
+        }
+    }
+}
+
+void count_init(
+    sparse_count_matrix_t const& dwcm,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics const& tokens,
+    const model_sharing sharing) {
+
+    const std::size_t n_docs = dwcm.rows();
+    std::size_t pos = 0;
+
+    for(std::size_t d = 0; d < n_docs; ++d) {
+        const auto dwcm_end = dwcm.end(d);
+        for(sparse_count_matrix_t::ConstIterator it = dwcm.begin(d); it != dwcm_end; ++it) {
+            const std::size_t w = it->index();
+            const std::size_t k_max = static_cast<std::size_t>(it->value());
+            for(std::size_t k = 0; k < k_max; k++) {
+                const std::size_t top = tokens.get(pos);
+                tdcm(top, d) += 1;
+                add_count(twcm(top, w), 1, sharing == model_sharing::shared);
+                ++pos;
+            }
+        }
+    }
+}
+
+// reciprocal of (ztot + wbeta); the draw kernels multiply by it and the
+// kernels refresh the two entries a token changes
+//
+static inline void reciprocal_ztot(count_vector_t const& ztot, const double wbeta, DynamicVector<double> & rztot) {
+    const std::size_t n_topics = ztot.size();
+    rztot.resize(n_topics, false);
+    for(std::size_t t = 0; t < n_topics; ++t) {
+        rztot[t] = 1.0 / (ztot[t] + wbeta);
+    }
+}
+
+// cdf scratch buffer of draw_topic; a fixed size stack array for the
+// specialized topic counts (at most 8KB, HPX thread stacks are small) and
+// the caller's probs vector otherwise
+//
+template<std::size_t K>
+struct draw_scratch {
+    alignas(64) double buffer[K];
+
+    explicit draw_scratch(DynamicVector<double> &) {}
+    double * cdf() { return buffer; }
+};
+
+template<>
+struct draw_scratch<0> {
+    DynamicVector<double> & probs;
+
+    explicit draw_scratch(DynamicVector<double> & p) : probs(p) {}
+    double * cdf() { return probs.data(); }
+};
+
+static draw_kernel best_kernel() {
+    static const draw_kernel kernel = best_draw_kernel();
+    return kernel;
+}
+
+// column w of twcm as the draw kernels read it. when Shared other threads
+// add to the column while it is read, so it is copied into column with
+// relaxed atomic loads (load_count) and the kernel's vector loads read the
+// copy; a replica column is read in place
+//
+template<bool Shared>
+static inline const count_t * twcm_column(count_matrix_t const& twcm, const std::size_t w, std::vector<count_t> & column) {
+    const count_t * twcm_w = twcm.data(w);
+    if constexpr(Shared) {
+        const std::size_t n_topics = column.size();
+        for(std::size_t t = 0; t < n_topics; ++t) {
+            column[t] = load_count(twcm_w[t]);
+        }
+        return column.data();
+    }
+    else {
+        return twcm_w;
+    }
+}
+
+// twcm updates are atomic when Shared (model_sharing::shared)
+//
+template<std::size_t K, bool Shared>
+static void gibbs_sweep(
+    sparse_count_matrix_t const& dwcm,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens, count_vector_t & ztot,
     DynamicVector<double> & probs,
-    drand & dr,
-    const std::size_t n_topics, const double N, const double alpha, const double beta) {
+    counter_rng & rng,
+    const std::size_t n_topics, const double N, const double alpha, const double beta,
+    dirty_words * dirty) {
 
     const std::size_t n_docs = dwcm.rows();
     const double wbeta = N * beta;
 
-    std::vector<std::size_t>::iterator token_itr = tokens.begin();
+    DynamicVector<double> rztot;
+    reciprocal_ztot(ztot, wbeta, rztot);
+
+    draw_scratch<K> scratch(probs);
+    const draw_topic_fn draw = draw_topic_kernel(best_kernel(), n_topics);
+    std::vector<count_t> column(Shared ? n_topics : 0);
+
+    std::size_t pos = 0;
 
     for(std::size_t d = 0; d < n_docs; ++d) {
         const auto dwcm_end = dwcm.end(d);
-        for(CompressedMatrix<double, blaze::rowMajor>::ConstIterator it = dwcm.begin(d); it != dwcm_end; ++it) {
+        // tdcm and twcm are column-major (see counts.hpp); a column
+        // holds all topic counts of one document or word
+        //
+        const count_t * tdcm_d = tdcm.data(d);
+
+        rng.prefetch(pos, doc_tokens(dwcm, d));
+
+        for(sparse_count_matrix_t::ConstIterator it = dwcm.begin(d); it != dwcm_end; ++it) {
             const std::size_t w = it->index();
-            const std::size_t k_max = static_cast<std::size_t>(std::floor(it->value()));
+            const std::size_t k_max = static_cast<std::size_t>(it->value());
             for(std::size_t k = 0; k < k_max; k++) {
                 // decrement twcm, tdcm, ztot
                 //
-                //assert(token_itr != token_end);
-                std::size_t t = (*token_itr);
+                //assert(pos < tokens.size());
+                const std::size_t t = tokens.get(pos);
+                rng.seek(pos);
 
                 //assert(twcm(t, w) >= 0.0);
                 //assert(tdcm(t, d) >= 0.0);
                 //assert(ztot[t] >= 0.0);
 
-                ztot[t] -= 1.0;
-                twcm(t, w) -= 1.0;
-                tdcm(t, d) -= 1.0;
-
-                //double totprob = 0.0;
-                //for(std::size_t i = 0; i < n_topics; ++i) {
-                //    probs[i] = ((twcm(i,w) + beta) * (tdcm(i,d) + alpha)) / (ztot[i] + wbeta);
-                //    totprob += probs[i];
-                //}
-
-                probs = ((blaze::column(twcm, w) + beta) * (blaze::column(tdcm,d) + alpha)) / (ztot + wbeta);
-                const double totprob = blaze::sum(probs);
-                const double maxprob = totprob * dr();
-                std::size_t nt = 0;
-                double curprob = probs[nt];
-
-                while(curprob < maxprob) {
-                    ++nt;
-                    curprob += probs[nt];
+                ztot[t] -= 1;
+                add_count<Shared>(twcm(t, w), -1);
+                tdcm(t, d) -= 1;
+                rztot[t] = 1.0 / (ztot[t] + wbeta);
+
+                // counts are integers; convert where the probability is computed
+                //
+                const count_t * twcm_w = twcm_column<Shared>(twcm, w, column);
+                const std::size_t nt = draw(twcm_w, tdcm_d, rztot.data(), scratch.cdf(), rng(), n_topics, alpha, beta);
+
+                if(dirty != nullptr && nt != t) {
+                    dirty->mark(w);
                 }
 
-                nt = (nt >= n_topics) ? (nt % n_topics) : nt;
+                tokens.set(pos, nt);
+                ztot[nt] += 1;
+                rztot[nt] = 1.0 / (ztot[nt] + wbeta);
+                add_count<Shared>(twcm(nt, w), 1);
+                tdcm(nt, d) += 1;
+                ++pos;
+            }
+        }
+    }
+}
+
+// visits the words [first_word, last_word)
+//
+template<std::size_t K, bool Shared>
+static void gibbs_words_sweep(
+    word_order const& order,
+    const std::size_t first_word, const std::size_t last_word,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens, count_vector_t & ztot,
+    DynamicVector<double> & probs,
+    counter_rng & rng,
+    const std::size_t n_topics, const double N, const double alpha, const double beta,
+    dirty_words * dirty) {
+
+    const double wbeta = N * beta;
+
+    DynamicVector<double> rztot;
+    reciprocal_ztot(ztot, wbeta, rztot);
+
+    draw_scratch<K> scratch(probs);
+    const draw_topic_fn draw = draw_topic_kernel(best_kernel(), n_topics);
+    std::vector<count_t> column(Shared ? n_topics : 0);
+
+    for(std::size_t w = first_word; w < last_word; ++w) {
+        const std::size_t e_beg = order.offsets[w];
+        const std::size_t e_end = order.offsets[w+1];
 
-                (*token_itr) = nt;
-                ztot[nt] += 1.0;
-                twcm(nt, w) += 1.0;
-                tdcm(nt, d) += 1.0;
-                ++token_itr;
+        for(std::size_t e = e_beg; e < e_end; ++e) {
+            const std::size_t d = order.docs[e];
+            const std::size_t pos = order.positions[e];
+            const std::size_t t = tokens.get(pos);
+            const count_t * tdcm_d = tdcm.data(d);
+
+            // draws are keyed by token, so the word order consumes the
+            // same stream per token as the document order
+            //
+            rng.seek(pos);
+
+            ztot[t] -= 1;
+            add_count<Shared>(twcm(t, w), -1);
+            tdcm(t, d) -= 1;
+            rztot[t] = 1.0 / (ztot[t] + wbeta);
+
+            const count_t * twcm_w = twcm_column<Shared>(twcm, w, column);
+            const std::size_t nt = draw(twcm_w, tdcm_d, rztot.data(), scratch.cdf(), rng(), n_topics, alpha, beta);
+
+            if(dirty != nullptr && nt != t) {
+                dirty->mark(w);
             }
+
+            tokens.set(pos, nt);
+            ztot[nt] += 1;
+            rztot[nt] = 1.0 / (ztot[nt] + wbeta);
+            add_count<Shared>(twcm(nt, w), 1);
+            tdcm(nt, d) += 1;
         }
     }
 }
+
+void gibbs(
+    sparse_count_matrix_t const& dwcm,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens, count_vector_t & ztot,
+    DynamicVector<double> & probs,
+    counter_rng & rng,
+    const std::size_t n_topics, const double N, const double alpha, const double beta,
+    const model_sharing sharing,
+    dirty_words * dirty) {
+
+    with_fixed_topics(n_topics, [&](auto K) {
+        if(sharing == model_sharing::shared) {
+            gibbs_sweep<decltype(K)::value, true>(dwcm, tdcm, twcm, tokens, ztot, probs, rng, n_topics, N, alpha, beta, dirty);
+        }
+        else {
+            gibbs_sweep<decltype(K)::value, false>(dwcm, tdcm, twcm, tokens, ztot, probs, rng, n_topics, N, alpha, beta, dirty);
+        }
+    });
+}
+
+void gibbs_words(
+    word_order const& order,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens, count_vector_t & ztot,
+    DynamicVector<double> & probs,
+    counter_rng & rng,
+    const std::size_t n_topics, const double N, const double alpha, const double beta,
+    const model_sharing sharing,
+    dirty_words * dirty) {
+
+    const std::size_t n_words = order.offsets.size() - 1;
+
+    with_fixed_topics(n_topics, [&](auto K) {
+        if(sharing == model_sharing::shared) {
+            gibbs_words_sweep<decltype(K)::value, true>(order, 0, n_words, tdcm, twcm, tokens, ztot, probs, rng, n_topics, N, alpha, beta, dirty);
+        }
+        else {
+            gibbs_words_sweep<decltype(K)::value, false>(order, 0, n_words, tdcm, twcm, tokens, ztot, probs, rng, n_topics, N, alpha, beta, dirty);
+        }
+    });
+}
+
+void gibbs_word_block(
+    word_order const& order,
+    const std::size_t first_word, const std::size_t last_word,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens, count_vector_t & ztot,
+    DynamicVector<double> & probs,
+    counter_rng & rng,
+    const std::size_t n_topics, const double N, const double alpha, const double beta) {
+
+    with_fixed_topics(n_topics, [&](auto K) {
+        gibbs_words_sweep<decltype(K)::value, false>(order, first_word, last_word, tdcm, twcm, tokens, ztot, probs, rng, n_topics, N, alpha, beta, nullptr);
+    });
+}
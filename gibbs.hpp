@@ -8,24 +8,168 @@
 #ifndef __GIBBS_HPP__
 
 #include <vector>
+#include <string>
 #include <cmath>
 #include <cstdint>
 
 #include <blaze/Math.h>
 
-#include "drand.hpp"
+#include "counter_rng.hpp"
+#include "token_topics.hpp"
+#include "counts.hpp"
 
 using blaze::DynamicMatrix;
 using blaze::DynamicVector;
 using blaze::CompressedMatrix;
 
+// sampling kernel used by the trainers for each sweep
+//
+// dense  - computes the full topic distribution of every token, O(K)
+// sparse - SparseLDA bucket sampler, O(nonzero doc/word topics)
+// alias  - Metropolis-Hastings with alias table proposals, amortized O(1)
+//
+enum class sampler_type { dense, sparse, alias };
+
+bool sampler_from_string(std::string const& name, sampler_type & sampler);
+
+// order tokens are visited in during a sweep
+//
+// document - document by document, the order tokens are stored in
+// word     - grouped by word so a word's twcm column stays in cache while
+//            all of its occurrences are resampled (WarpLDA style)
+//
+enum class sweep_order { document, word };
+
+bool sweep_order_from_string(std::string const& name, sweep_order & order);
+
+// how the parallel trainer holds the topic-word model (twcm)
+//
+// replicated - each thread samples against its own copy of twcm; the
+//              copies are merged after every sweep
+// shared     - all threads sample against one twcm and update its counts
+//              with atomic adds; no copies and no merge. reads are
+//              relaxed atomic loads and may see other threads' updates
+//              mid-sweep
+//
+// the dense and alias kernels take the same argument; shared makes their
+// twcm updates and reads atomic. the sparse kernel needs a replica (see
+// sparse_gibbs.hpp)
+//
+enum class model_sharing { replicated, shared };
+
+bool model_sharing_from_string(std::string const& name, model_sharing & sharing);
+
+// words whose twcm column changed during a sweep; a kernel given one marks
+// a word whenever one of its tokens moves to another topic, so the
+// parallel trainers merge only those columns of the per-thread replicas
+//
+struct dirty_words {
+    std::vector<std::uint8_t> flags;
+    std::vector<std::size_t> words;
+
+    void resize(const std::size_t n_words) {
+        flags.assign(n_words, 0);
+        words.clear();
+    }
+
+    void mark(const std::size_t w) {
+        if(flags[w] == 0) {
+            flags[w] = 1;
+            words.push_back(w);
+        }
+    }
+
+    void clear() {
+        for(const std::size_t w : words) {
+            flags[w] = 0;
+        }
+        words.clear();
+    }
+};
+
+// tokens of a shard grouped by word; the occurrences of word w are the
+// entries [offsets[w], offsets[w+1]) of docs/positions, where positions
+// index the shard's document ordered token vector
+//
+struct word_order {
+    std::vector<std::size_t> offsets;
+    std::vector<std::uint32_t> docs;
+    std::vector<std::size_t> positions;
+};
+
+void build_word_order(sparse_count_matrix_t const& dwcm, const std::size_t n_words, word_order & order);
+
+// number of tokens in document d
+//
+std::size_t doc_tokens(sparse_count_matrix_t const& dwcm, const std::size_t d);
+
+// number of documents in the shards of thread_idx
+//
+std::size_t shard_documents(std::vector<std::size_t> const& thread_idx, std::vector< sparse_count_matrix_t > const& dwcm);
+
+// assigns every token a uniformly random topic and adds it to tdcm and
+// twcm; the draws are keyed by the token's global position (see
+// counter_rng) so the assignment only depends on the seed
+//
+void random_init(
+    sparse_count_matrix_t const& dwcm,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens,
+    counter_rng & rng,
+    const std::size_t n_topics,
+    const model_sharing sharing = model_sharing::replicated);
+
+// adds the topics tokens already hold to tdcm and twcm; takes the place
+// of random_init when a trainer resumes from a checkpoint (checkpoint.hpp)
+//
+void count_init(
+    sparse_count_matrix_t const& dwcm,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics const& tokens,
+    const model_sharing sharing = model_sharing::replicated);
+
+// dense kernel; probs (n_topics entries) is scratch space for the
+// cumulative topic distribution built by the draw kernels (topic_draw.hpp)
+// and goes unused when n_topics is one of fixed_topic_counts
+//
 void gibbs(
-    CompressedMatrix<double> const& dwcm,
-    DynamicMatrix<double> & tdcm,
-    DynamicMatrix<double> & twcm,
-    std::vector<std::size_t> & tokens, DynamicVector<double> & ztot,
+    sparse_count_matrix_t const& dwcm,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens, count_vector_t & ztot,
+    DynamicVector<double> & probs,
+    counter_rng & rng,
+    const std::size_t n_topics, const double N, const double alpha, const double beta,
+    const model_sharing sharing = model_sharing::replicated,
+    dirty_words * dirty = nullptr);
+
+// dense kernel visiting tokens in word order (sweep_order::word)
+//
+void gibbs_words(
+    word_order const& order,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens, count_vector_t & ztot,
+    DynamicVector<double> & probs,
+    counter_rng & rng,
+    const std::size_t n_topics, const double N, const double alpha, const double beta,
+    const model_sharing sharing = model_sharing::replicated,
+    dirty_words * dirty = nullptr);
+
+// gibbs_words restricted to the words [first_word, last_word); the caller
+// guarantees no other thread updates those columns of twcm meanwhile
+// (rotation_train_lda in parldalib.hpp)
+//
+void gibbs_word_block(
+    word_order const& order,
+    const std::size_t first_word, const std::size_t last_word,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens, count_vector_t & ztot,
     DynamicVector<double> & probs,
-    drand & dr,
+    counter_rng & rng,
     const std::size_t n_topics, const double N, const double alpha, const double beta);
 
 #endif
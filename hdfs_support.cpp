@@ -7,6 +7,7 @@
 #include "hdfs_support.hpp"
 
 #include <sstream>
+#include <algorithm>
 
 #include <unicode/unistr.h>
 #include <unicode/ustream.h>
@@ -214,6 +215,19 @@ std::size_t path_to_vector(hdfs_context & ctx, std::string const& p, std::vector
     return paths.size();
 }
 
+void path_sizes(hdfs_context & ctx, std::vector<fs::path> const& paths, std::vector<std::size_t> & sizes) {
+    sizes.resize(paths.size());
+    std::transform(std::begin(paths), std::end(paths), std::begin(sizes), [&ctx](fs::path const& p) {
+        std::size_t sz = 0;
+        hdfsFileInfo * fi = hdfsGetPathInfo(ctx.filesystem, p.c_str());
+        if(fi != nullptr) {
+            sz = static_cast<std::size_t>(fi->mSize);
+            hdfsFreeFileInfo(fi, 1);
+        }
+        return sz;
+    });
+}
+
 std::size_t document_path_to_inverted_index(hdfs_context & ctx, std::vector<fs::path>::iterator & beg, std::vector<fs::path>::iterator & end, UnicodeString & regexp, inverted_index_t & ii) {
     std::vector<UnicodeString> files_content;
     read_file_content(ctx, beg, end, files_content);
@@ -258,7 +272,7 @@ std::size_t document_path_to_inverted_index(hdfs_context & ctx, std::vector<fs::
     return entry_count;
 }
 
-void json_topic_matrices(hdfs_context & ctx, std::string const& prefix, std::vector<CompressedMatrix<double>> const& dwcm, std::vector<DynamicMatrix<double>> const& tdcm, std::vector<DynamicMatrix<double>> const& twcm) {
+void json_topic_matrices(hdfs_context & ctx, std::string const& prefix, std::vector<sparse_count_matrix_t> const& dwcm, std::vector<count_matrix_t> const& tdcm, std::vector<count_matrix_t> const& twcm) {
 
     std::string content{};
     {
@@ -332,7 +346,7 @@ void json_topic_matrices(hdfs_context & ctx, std::string const& prefix, std::vec
     rc = hdfsCloseFile(ctx.filesystem, out);
 }
 
-void json_topic_matrices(hdfs_context & ctx, const std::size_t locality, std::string const& prefix, std::vector<CompressedMatrix<double>> const& dwcm, std::vector<DynamicMatrix<double>> const& tdcm, std::vector<DynamicMatrix<double>> const& twcm) {
+void json_topic_matrices(hdfs_context & ctx, const std::size_t locality, std::string const& prefix, std::vector<sparse_count_matrix_t> const& dwcm, std::vector<count_matrix_t> const& tdcm, std::vector<count_matrix_t> const& twcm) {
     std::string tprefix{ prefix + "_" + std::to_string(locality) };
     json_topic_matrices(ctx, tprefix, dwcm, tdcm, twcm);
 }
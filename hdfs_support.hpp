@@ -19,6 +19,7 @@
 #include <hdfs/hdfs.h>
 
 #include "inverted_index.hpp"
+#include "counts.hpp"
 
 namespace fs = std::experimental::filesystem;
 using blaze::DynamicMatrix;
@@ -51,12 +52,14 @@ std::size_t load_wordlist(hdfs_context & ctx, fs::path const& pth, std::unordere
 
 std::size_t path_to_vector(hdfs_context & ctx, std::string const& p, std::vector<fs::path> & paths);
 
+void path_sizes(hdfs_context & ctx, std::vector<fs::path> const& paths, std::vector<std::size_t> & sizes);
+
 std::size_t document_path_to_inverted_index(hdfs_context & ctx, std::vector<fs::path>::iterator & beg, std::vector<fs::path>::iterator & end, UnicodeString & regexp, inverted_index_t & ii, std::unordered_map<std::string, std::size_t> const& voc);
 
 std::size_t document_path_to_inverted_index(hdfs_context & ctx, std::vector<fs::path>::iterator & beg, std::vector<fs::path>::iterator & end, UnicodeString & regexp, inverted_index_t & ii);
 
-void json_topic_matrices(hdfs_context & ctx, std::string const& prefix, std::vector<CompressedMatrix<double>> const& dwcm, std::vector<DynamicMatrix<double>> const& tdcm, std::vector<DynamicMatrix<double>> const& twcm);
+void json_topic_matrices(hdfs_context & ctx, std::string const& prefix, std::vector<sparse_count_matrix_t> const& dwcm, std::vector<count_matrix_t> const& tdcm, std::vector<count_matrix_t> const& twcm);
 
-void json_topic_matrices(hdfs_context & ctx, const std::size_t locality, std::string const& prefix, std::vector<CompressedMatrix<double>> const& dwcm, std::vector<DynamicMatrix<double>> const& tdcm, std::vector<DynamicMatrix<double>> const& twcm);
+void json_topic_matrices(hdfs_context & ctx, const std::size_t locality, std::string const& prefix, std::vector<sparse_count_matrix_t> const& dwcm, std::vector<count_matrix_t> const& tdcm, std::vector<count_matrix_t> const& twcm);
 
 #endif
@@ -0,0 +1,235 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <hpx/config.hpp>
+#include <hpx/hpx.hpp>
+#include <hpx/modules/collectives.hpp>
+#include <hpx/serialization/string.hpp>
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+
+#include <unistd.h>
+#include <limits.h>
+
+#include "hierarchical_reduce.hpp"
+
+using namespace hpx::collectives;
+
+bool reduce_algorithm_from_string(std::string const& name, reduce_algorithm & algorithm) {
+    if(name == "auto") {
+        algorithm = reduce_algorithm::automatic;
+        return true;
+    }
+    else if(name == "flat") {
+        algorithm = reduce_algorithm::flat;
+        return true;
+    }
+    else if(name == "hierarchical") {
+        algorithm = reduce_algorithm::hierarchical;
+        return true;
+    }
+
+    return false;
+}
+
+locality_topology discover_topology(const std::size_t n_locales, const std::size_t locality_id) {
+    char name[HOST_NAME_MAX+1] = { 0 };
+    gethostname(name, HOST_NAME_MAX);
+
+    const std::string all_gather_hosts_basename = "all_gather_hosts";
+    auto all_gather_hosts_client = create_communicator(
+        all_gather_hosts_basename.c_str(), num_sites_arg(n_locales), this_site_arg(locality_id)
+    );
+
+    const std::vector<std::string> hosts =
+        hpx::collectives::all_gather(all_gather_hosts_client, std::string{name}).get();
+
+    locality_topology topology;
+    topology.n_nodes = 0;
+    topology.node_of.resize(n_locales);
+
+    std::vector<std::string> nodes;
+    for(std::size_t l = 0; l < n_locales; ++l) {
+        const auto n = std::find(std::begin(nodes), std::end(nodes), hosts[l]);
+        topology.node_of[l] = static_cast<std::size_t>(n - std::begin(nodes));
+        if(n == std::end(nodes)) {
+            nodes.push_back(hosts[l]);
+        }
+    }
+
+    topology.n_nodes = nodes.size();
+    topology.node = topology.node_of[locality_id];
+    for(std::size_t l = 0; l < n_locales; ++l) {
+        if(topology.node_of[l] == topology.node) {
+            if(l == locality_id) {
+                topology.node_rank = topology.node_localities.size();
+            }
+            topology.node_localities.push_back(l);
+        }
+    }
+
+    return topology;
+}
+
+reduce_algorithm choose_reduce_algorithm(const reduce_algorithm requested, locality_topology const& topology) {
+    if(requested != reduce_algorithm::automatic) {
+        return requested;
+    }
+
+    const bool shared_node = topology.node_of.size() > topology.n_nodes;
+    return (shared_node || topology.n_nodes > 2) ? reduce_algorithm::hierarchical : reduce_algorithm::flat;
+}
+
+std::string describe_reduction(const reduce_algorithm algorithm, locality_topology const& topology) {
+    const std::size_t n_locales = topology.node_of.size();
+
+    std::vector<std::size_t> per_node(topology.n_nodes, 0);
+    for(const std::size_t n : topology.node_of) {
+        ++per_node[n];
+    }
+
+    std::ostringstream line;
+    if(algorithm == reduce_algorithm::hierarchical) {
+        line << "hierarchical reduction, " << n_locales << " localities on " << topology.n_nodes << " nodes (localities per node";
+        for(const std::size_t c : per_node) {
+            line << ' ' << c;
+        }
+        line << ')';
+        if(topology.n_nodes > 1) {
+            line << ", ring over " << topology.n_nodes << " node leaders";
+        }
+    }
+    else {
+        line << "flat all_reduce over " << n_locales << " localities on " << topology.n_nodes << " nodes";
+    }
+    return line.str();
+}
+
+delta_reducer::delta_reducer(std::string const& basename,
+                  const std::size_t n_locales, const std::size_t locality_id,
+                  locality_topology const& topo,
+                  const reduce_algorithm requested,
+                  const std::size_t first_word, const std::size_t last_word)
+    : algorithm(choose_reduce_algorithm(requested, topo)), topology(topo), ring_bounds(), calls(0),
+      flat_client(), node_client(), ring_client() {
+
+    if(algorithm == reduce_algorithm::flat) {
+        flat_client = create_communicator(
+            basename.c_str(), num_sites_arg(n_locales), this_site_arg(locality_id)
+        );
+        return;
+    }
+
+    const std::size_t node_size = topology.node_localities.size();
+    if(node_size > 1) {
+        const std::string node_basename = basename + "_node_" + std::to_string(topology.node);
+        node_client = create_communicator(
+            node_basename.c_str(), num_sites_arg(node_size), this_site_arg(topology.node_rank)
+        );
+    }
+
+    // leader r of the ring owns words [ring_bounds[r], ring_bounds[r+1])
+    // after the reduce-scatter
+    //
+    if(topology.node_rank == 0 && topology.n_nodes > 1) {
+        const std::string ring_basename = basename + "_ring";
+        ring_client = create_channel_communicator(hpx::launch::sync,
+            ring_basename.c_str(), num_sites_arg(topology.n_nodes), this_site_arg(topology.node)
+        );
+
+        const std::size_t n_words = last_word - first_word;
+        ring_bounds.resize(topology.n_nodes+1);
+        for(std::size_t r = 0; r <= topology.n_nodes; ++r) {
+            ring_bounds[r] = first_word + (r * n_words) / topology.n_nodes;
+        }
+    }
+}
+
+hpx::future<delta_payload> delta_reducer::reduce(delta_payload const& p) {
+    if(algorithm == reduce_algorithm::flat) {
+        return hpx::collectives::all_reduce(flat_client, p, delta_adder{});
+    }
+
+    const std::size_t call = calls++;
+    return hpx::async([this, p, call]() { return hierarchical_reduce(p, call); });
+}
+
+delta_payload delta_reducer::ring_all_reduce(delta_payload const& p, const std::size_t call) {
+    const std::size_t n_ring = topology.n_nodes;
+    const std::size_t r = topology.node;
+    const std::size_t next = (r + 1) % n_ring;
+    const std::size_t prev = (r + n_ring - 1) % n_ring;
+
+    std::vector<delta_payload> parts;
+    split_delta(p, ring_bounds, parts);
+
+    // tags keep the messages of different steps and calls apart
+    //
+    const std::size_t tag = call * 2 * n_ring;
+
+    // reduce-scatter; after step s, part (r - s - 1) holds the sum of
+    // s + 2 leaders, and after n_ring - 1 steps part (r + 1) is complete
+    //
+    for(std::size_t s = 0; s + 1 < n_ring; ++s) {
+        const std::size_t send = (r + n_ring - s) % n_ring;
+        const std::size_t recv = (r + 2 * n_ring - s - 1) % n_ring;
+
+        hpx::future<void> sent = set(ring_client, that_site_arg(next), parts[send], tag_arg(tag + s));
+        const delta_payload received = get<delta_payload>(ring_client, that_site_arg(prev), tag_arg(tag + s)).get();
+        parts[recv] = delta_adder{}(parts[recv], received);
+        sent.get();
+    }
+
+    // all-gather; every leader passes on the complete part it received
+    //
+    for(std::size_t s = 0; s + 1 < n_ring; ++s) {
+        const std::size_t send = (r + 1 + n_ring - s) % n_ring;
+        const std::size_t recv = (r + n_ring - s) % n_ring;
+
+        hpx::future<void> sent = set(ring_client, that_site_arg(next), parts[send], tag_arg(tag + n_ring + s));
+        parts[recv] = get<delta_payload>(ring_client, that_site_arg(prev), tag_arg(tag + n_ring + s)).get();
+        sent.get();
+    }
+
+    delta_payload out;
+    join_delta(parts, ring_bounds, out);
+    return out;
+}
+
+delta_payload delta_reducer::hierarchical_reduce(delta_payload p, const std::size_t call) {
+    const std::size_t node_size = topology.node_localities.size();
+    const bool leader = (topology.node_rank == 0);
+
+    // combine this node's localities at its leader
+    //
+    if(node_size > 1) {
+        if(leader) {
+            p = reduce_here(node_client, std::move(p), delta_adder{}, this_site_arg(topology.node_rank)).get();
+        }
+        else {
+            reduce_there(node_client, std::move(p), this_site_arg(topology.node_rank)).get();
+        }
+    }
+
+    if(leader && topology.n_nodes > 1) {
+        p = ring_all_reduce(p, call);
+    }
+
+    if(node_size > 1) {
+        if(leader) {
+            broadcast_to(node_client, p, this_site_arg(topology.node_rank)).get();
+        }
+        else {
+            p = broadcast_from<delta_payload>(node_client, this_site_arg(topology.node_rank)).get();
+        }
+    }
+
+    return p;
+}
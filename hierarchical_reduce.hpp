@@ -0,0 +1,96 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __MINIATURIST_HIERARCHICAL_REDUCE_HPP__
+#define __MINIATURIST_HIERARCHICAL_REDUCE_HPP__
+
+#include <hpx/config.hpp>
+#include <hpx/future.hpp>
+#include <hpx/modules/collectives.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "delta_payload.hpp"
+
+// how distpar_train_lda sums the localities' topic-word differences
+//
+// flat         - one all_reduce over all localities
+// hierarchical - the localities of each node (host) are summed at the
+//                node's first locality, the leaders sum the node totals
+//                with a ring reduce-scatter followed by a ring all-gather
+//                (each leader sends and receives about 2 x payload bytes
+//                however many nodes there are), and each leader hands the
+//                result to its node's other localities. only the ring
+//                crosses the network
+// automatic    - hierarchical when a node runs more than one locality or
+//                there are more than two nodes, flat otherwise
+//
+enum class reduce_algorithm { automatic, flat, hierarchical };
+
+bool reduce_algorithm_from_string(std::string const& name, reduce_algorithm & algorithm);
+
+// which node (host name) each locality runs on; nodes are numbered in the
+// order of their first locality
+//
+struct locality_topology {
+    std::size_t n_nodes;
+    std::vector<std::size_t> node_of;
+
+    // localities on this locality's node in increasing order; the first is
+    // the node's leader
+    //
+    std::vector<std::size_t> node_localities;
+    std::size_t node;
+    std::size_t node_rank;
+};
+
+// gathers every locality's host name; called on every locality
+//
+locality_topology discover_topology(const std::size_t n_locales, const std::size_t locality_id);
+
+// resolves reduce_algorithm::automatic
+//
+reduce_algorithm choose_reduce_algorithm(const reduce_algorithm requested, locality_topology const& topology);
+
+// one line naming the algorithm and the topology it runs on, for the log
+//
+std::string describe_reduction(const reduce_algorithm algorithm, locality_topology const& topology);
+
+// sums a delta_payload over all localities with the given algorithm; every
+// locality constructs one with the same basename and words and calls
+// reduce the same number of times. payloads only hold words
+// [first_word, last_word); the ring splits that range between the nodes.
+// one reduction may be in flight at a time
+//
+class delta_reducer {
+public:
+    delta_reducer(std::string const& basename,
+                  const std::size_t n_locales, const std::size_t locality_id,
+                  locality_topology const& topology,
+                  const reduce_algorithm algorithm,
+                  const std::size_t first_word, const std::size_t last_word);
+
+    hpx::future<delta_payload> reduce(delta_payload const& p);
+
+private:
+    delta_payload ring_all_reduce(delta_payload const& p, const std::size_t call);
+
+    delta_payload hierarchical_reduce(delta_payload p, const std::size_t call);
+
+    reduce_algorithm algorithm;
+    locality_topology topology;
+    std::vector<std::size_t> ring_bounds;
+    std::size_t calls;
+
+    hpx::collectives::communicator flat_client;
+    hpx::collectives::communicator node_client;
+    hpx::collectives::channel_communicator ring_client;
+};
+
+#endif
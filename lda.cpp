@@ -18,6 +18,7 @@
 #include "results.hpp"
 #include "inverted_index.hpp"
 #include "documents.hpp"
+#include "checkpoint.hpp"
 
 #ifdef ICU69
 using namespace icu_69;
@@ -40,6 +41,11 @@ int main(int argc, char ** argv) {
     double alpha = 0.1;
     double beta = 0.01;
     std::string jsonprefix{};
+    sampler_type sampler = sampler_type::dense;
+    std::uint64_t seed = 0;
+    std::string checkpoint_path{};
+    std::size_t checkpoint_every = 0;
+    bool resume = false;
 
     {
         bool halt = false;
@@ -55,6 +61,11 @@ int main(int argc, char ** argv) {
                 {"alpha",  optional_argument,     NULL, 'a' },
                 {"beta",  optional_argument,      NULL, 'b' },
                 {"json",  optional_argument,      NULL, 'j' },
+                {"sampler",  optional_argument,   NULL, 's' },
+                {"seed",  optional_argument,      NULL, 'e' },
+                {"checkpoint",  optional_argument, NULL, 'p' },
+                {"checkpoint_every",  optional_argument, NULL, 'k' },
+                {"resume",  no_argument,          NULL, 'u' },
                 {NULL,      0,                    NULL,  0 }
             };
 
@@ -106,6 +117,34 @@ int main(int argc, char ** argv) {
 			jsonprefix = std::string{optarg};
                         break;
 		    }
+                    case 's':
+                    {
+                        if(!sampler_from_string(std::string{optarg}, sampler)) {
+                            std::cerr << "Please specify '--sampler=[dense|sparse|alias]'" << std::endl;
+                            return 1;
+                        }
+                        break;
+                    }
+                    case 'e':
+                    {
+                        seed = static_cast<std::uint64_t>(std::stoull(optarg));
+                        break;
+                    }
+                    case 'p':
+                    {
+                        checkpoint_path = std::string{optarg};
+                        break;
+                    }
+                    case 'k':
+                    {
+                        checkpoint_every = static_cast<std::size_t>(std::stoull(optarg));
+                        break;
+                    }
+                    case 'u':
+                    {
+                        resume = true;
+                        break;
+                    }
                 }
             }
         }
@@ -125,6 +164,11 @@ int main(int argc, char ** argv) {
             exit = true;
         }
 
+        if(resume && checkpoint_path.size() < 1) {
+            std::cerr << "'--resume' requires '--checkpoint=checkpoint-file'" << std::endl;
+            exit = true;
+        }
+
         if(exit) {
             return 1;
         }
@@ -134,10 +178,10 @@ int main(int argc, char ** argv) {
 
     const std::size_t vocab_sz = load_wordlist(wpth, vocabulary);
 
-    CompressedMatrix<double> dwcm;
-    DynamicMatrix<double> tdcm, twcm;
+    sparse_count_matrix_t dwcm;
+    count_matrix_t tdcm, twcm;
 
-    std::vector<std::size_t> tokens;
+    token_topics tokens;
 
     std::vector< fs::path > paths;
     {
@@ -150,16 +194,38 @@ int main(int argc, char ** argv) {
 
         tdcm.resize( n_topics, ndocs );
         twcm.resize( n_topics, vocab_sz );
-        tdcm = 0.0;
-        twcm = 0.0;
+        tdcm = 0;
+        twcm = 0;
 
         document_path_to_inverted_index(beg, end, regexp, ii, vocabulary);
         inverted_index_to_matrix(vocabulary, ii, ndocs, dwcm);
         dwcm = blaze::trans(dwcm);
-        matrix_to_vector(dwcm, tokens);
+        matrix_to_vector(dwcm, tokens, n_topics);
+    }
+
+    // with --resume the tokens take the topics of the newest checkpoint
+    // and training continues after its iteration
+    //
+    checkpoint_config checkpoint;
+    checkpoint.path = checkpoint_path;
+    checkpoint.every = checkpoint_every;
+
+    if(resume) {
+        training_checkpoint resumed;
+        if(!read_latest_checkpoint(checkpoint_path, resumed)) {
+            std::cerr << "Could not read a checkpoint from '" << checkpoint_path << "'" << std::endl;
+            return 1;
+        }
+
+        if(resumed.seed != seed || !restore_checkpoint(resumed, n_topics, dwcm.rows(), tokens)) {
+            std::cerr << "The checkpoint '" << checkpoint_path << "' was taken with a different corpus, seed or number of topics" << std::endl;
+            return 1;
+        }
+
+        checkpoint.first_iteration = static_cast<std::size_t>(resumed.iterations);
     }
 
-    train_lda(dwcm, tdcm, twcm, tokens, n_topics, iterations, alpha, beta);
+    train_lda(dwcm, tdcm, twcm, tokens, n_topics, iterations, alpha, beta, sampler, seed, checkpoint);
 
     if(jsonprefix.size() < 1) {
         print_topics(vocabulary, twcm, n_topics);
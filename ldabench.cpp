@@ -0,0 +1,329 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <hpx/config.hpp>
+#if !defined(HPX_COMPUTE_DEVICE_CODE)
+#include <hpx/hpx.hpp>
+#include <hpx/hpx_init.hpp>
+#include <hpx/program_options.hpp>
+#include <hpx/algorithm.hpp>
+
+#include <vector>
+#include <map>
+#include <string>
+#include <numeric>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+
+#include <blaze/Math.h>
+
+#include "parldalib.hpp"
+#include "gibbs.hpp"
+#include "topic_draw.hpp"
+#include "counts.hpp"
+#include "documents.hpp"
+
+// synthetic corpus: document lengths are uniform in [1, 2*doc_len) and
+// words follow a zipf distribution over the vocabulary, which is what
+// natural language corpora look like to the samplers
+//
+static void synthetic_corpus(const std::size_t n_docs, const std::size_t doc_len, const std::size_t vocab_sz, const double zipf, const std::size_t seed, sparse_count_matrix_t & dwcm) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<std::size_t> len_dis(1, std::max<std::size_t>(2*doc_len, 2) - 1);
+
+    std::vector<double> weights(vocab_sz);
+    for(std::size_t w = 0; w < vocab_sz; ++w) {
+        weights[w] = 1.0 / std::pow(static_cast<double>(w+1), zipf);
+    }
+    std::discrete_distribution<std::size_t> word_dis(weights.begin(), weights.end());
+
+    dwcm.resize(n_docs, vocab_sz, false);
+    dwcm.reserve(n_docs * std::min(doc_len, vocab_sz));
+
+    std::map<std::size_t, count_t> doc;
+    for(std::size_t d = 0; d < n_docs; ++d) {
+        doc.clear();
+        const std::size_t len = len_dis(gen);
+        for(std::size_t k = 0; k < len; ++k) {
+            doc[word_dis(gen)] += 1;
+        }
+        for(const auto & wc : doc) {
+            dwcm.append(d, wc.first, wc.second);
+        }
+        dwcm.finalize(d);
+    }
+}
+
+// times the topic draw of the dense sampler for one word/document column
+// pair: the original blaze expression (double counts, a division per
+// topic and a linear walk) against every draw_kernel the cpu supports;
+// the kernels pay for the two reciprocal updates a real token makes
+//
+static void draw_bench(const std::size_t n_topics, const std::size_t n_draws, const double alpha, const double beta) {
+    std::mt19937 gen(0);
+    std::uniform_int_distribution<count_t> count_dis(0, 16);
+    std::uniform_real_distribution<double> u_dis(0.0, 1.0);
+
+    blaze::DynamicVector<count_t> twcm_w(n_topics), tdcm_d(n_topics);
+    count_vector_t ztot(n_topics);
+    for(std::size_t t = 0; t < n_topics; ++t) {
+        twcm_w[t] = count_dis(gen);
+        tdcm_d[t] = count_dis(gen);
+        ztot[t] = twcm_w[t] + (count_dis(gen) * 1000);
+    }
+
+    // wbeta of a one million token corpus
+    //
+    const double wbeta = 1000000.0 * beta;
+
+    std::vector<double> us(n_draws);
+    for(double & u : us) {
+        u = u_dis(gen);
+    }
+
+    // keeps the compiler from discarding the draws
+    //
+    volatile std::size_t sink = 0;
+
+    std::cout << "kernel\tdraws\tseconds\tdraws/sec" << std::endl;
+
+    {
+        DynamicVector<double> twcm_wd(twcm_w), tdcm_dd(tdcm_d), ztotd(ztot), probs(n_topics);
+
+        const auto start = std::chrono::steady_clock::now();
+        for(const double u : us) {
+            probs = ((twcm_wd + beta) * (tdcm_dd + alpha)) / (ztotd + wbeta);
+            const double maxprob = blaze::sum(probs) * u;
+            std::size_t nt = 0;
+            double curprob = probs[nt];
+            while(curprob < maxprob && (nt + 1) < n_topics) {
+                ++nt;
+                curprob += probs[nt];
+            }
+            sink = sink + nt;
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "blaze\t" << n_draws << '\t' << elapsed.count() << '\t'
+                  << (static_cast<double>(n_draws) / elapsed.count()) << std::endl;
+    }
+
+    for(const draw_kernel kernel : { draw_kernel::scalar, draw_kernel::avx2, draw_kernel::avx512 }) {
+        const draw_topic_fn generic = draw_topic_kernel(kernel);
+        if(generic == nullptr) {
+            continue;
+        }
+
+        // the specialized kernel is only timed when n_topics has one
+        //
+        const draw_topic_fn fixed = draw_topic_kernel(kernel, n_topics);
+        const std::string name = draw_kernel_name(kernel);
+
+        for(const bool specialized : { false, true }) {
+            if(specialized && fixed == generic) {
+                continue;
+            }
+
+            const draw_topic_fn draw = specialized ? fixed : generic;
+
+            DynamicVector<double> rztot(n_topics), cdf(n_topics);
+            for(std::size_t t = 0; t < n_topics; ++t) {
+                rztot[t] = 1.0 / (ztot[t] + wbeta);
+            }
+
+            std::size_t t = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for(const double u : us) {
+                rztot[t] = 1.0 / (ztot[t] + wbeta);
+                t = draw(twcm_w.data(), tdcm_d.data(), rztot.data(), cdf.data(), u, n_topics, alpha, beta);
+                rztot[t] = 1.0 / (ztot[t] + wbeta);
+                sink = sink + t;
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            std::cout << (specialized ? (name + "/fixed") : name) << '\t' << n_draws << '\t' << elapsed.count() << '\t'
+                      << (static_cast<double>(n_draws) / elapsed.count()) << std::endl;
+        }
+    }
+}
+
+int hpx_main(hpx::program_options::variables_map & vm) {
+    const std::size_t n_threads = hpx::resource::get_num_threads("default");
+    const std::size_t n_docs = vm["num_docs"].as<std::size_t>();
+    const std::size_t doc_len = vm["doc_len"].as<std::size_t>();
+    const std::size_t vocab_sz = vm["vocab_size"].as<std::size_t>();
+    const std::size_t n_topics = vm["num_topics"].as<std::size_t>();
+    const std::size_t iterations = vm["num_iters"].as<std::size_t>();
+    const double zipf = vm["zipf"].as<double>();
+    const double alpha = vm["alpha"].as<double>();
+    const double beta = vm["beta"].as<double>();
+
+    sampler_type sampler = sampler_type::dense;
+    if(!sampler_from_string(vm["sampler"].as<std::string>(), sampler)) {
+        std::cerr << "Please specify '--sampler=[dense|sparse|alias]'" << std::endl;
+        return hpx::finalize();
+    }
+
+    const std::uint64_t seed = vm["seed"].as<std::uint64_t>();
+
+    if(vm.count("draw_bench")) {
+        draw_bench(n_topics, vm["draws"].as<std::size_t>(), alpha, beta);
+        return hpx::finalize();
+    }
+
+    std::vector<sweep_order> orders;
+    {
+        const std::string sweep = vm["sweep"].as<std::string>();
+        sweep_order order = sweep_order::document;
+        if(sweep == "both") {
+            orders.push_back(sweep_order::document);
+            orders.push_back(sweep_order::word);
+        }
+        else if(sweep_order_from_string(sweep, order)) {
+            orders.push_back(order);
+        }
+        else {
+            std::cerr << "Please specify '--sweep=[document|word|both]'" << std::endl;
+            return hpx::finalize();
+        }
+    }
+
+    // "rotation" runs rotation_train_lda, the others par_train_lda
+    //
+    std::vector<std::string> models;
+    {
+        const std::string model = vm["model"].as<std::string>();
+        model_sharing sharing = model_sharing::replicated;
+        if(model == "all") {
+            models = { "replicated", "shared", "rotation" };
+        }
+        else if(model == "rotation" || model_sharing_from_string(model, sharing)) {
+            models.push_back(model);
+        }
+        else {
+            std::cerr << "Please specify '--model=[replicated|shared|rotation|all]'" << std::endl;
+            return hpx::finalize();
+        }
+    }
+
+    std::vector< std::size_t > thread_idx(n_threads);
+    std::iota(std::begin(thread_idx), std::end(thread_idx), 0);
+
+    std::vector< sparse_count_matrix_t > dwcm(n_threads);
+    std::vector< count_matrix_t > tdcm(n_threads), twcm(n_threads);
+    std::vector< token_topics > tokens(n_threads);
+
+    std::size_t n_tokens = 0, token_bytes = 0;
+    {
+        const std::size_t chunk_sz = n_docs / n_threads;
+        for(const std::size_t i : thread_idx) {
+            const std::size_t ndocs = ( i != (n_threads-1) ) ? chunk_sz : (n_docs - (i * chunk_sz));
+            synthetic_corpus(ndocs, doc_len, vocab_sz, zipf, i, dwcm[i]);
+            matrix_to_vector(dwcm[i], tokens[i], n_topics);
+            n_tokens += tokens[i].size();
+            token_bytes += tokens[i].bytes();
+        }
+    }
+
+    std::cout << "threads\t" << n_threads << "\tdocuments\t" << n_docs << "\ttokens\t" << n_tokens
+              << "\tvocabulary\t" << vocab_sz << "\ttopics\t" << n_topics
+              << "\ttopic_bits\t" << tokens[0].bits << "\ttoken_bytes\t" << token_bytes << std::endl;
+    std::cout << "sweep\tmodel\titerations\tseconds\ttokens/sec" << std::endl;
+
+    for(const std::string & model : models) {
+        const bool rotation = (model == "rotation");
+        model_sharing sharing = model_sharing::replicated;
+        model_sharing_from_string(model, sharing);
+
+        for(const sweep_order order : orders) {
+            if(order == sweep_order::word && sampler != sampler_type::dense) {
+                std::cerr << "'--sweep=word' requires '--sampler=dense'" << std::endl;
+                continue;
+            }
+
+            // rotation always samples in word order with the dense sampler
+            //
+            if(rotation && (order != sweep_order::word || sampler != sampler_type::dense)) {
+                continue;
+            }
+
+            for(const std::size_t i : thread_idx) {
+                tdcm[i].resize(n_topics, dwcm[i].rows(), false);
+                tdcm[i] = 0;
+
+                // shared and rotation models only use twcm[0]; release the
+                // replicas so the memory footprint matches parlda's
+                //
+                if(i == 0 || (sharing == model_sharing::replicated && !rotation)) {
+                    twcm[i].resize(n_topics, vocab_sz, false);
+                    twcm[i] = 0;
+                }
+                else {
+                    twcm[i] = count_matrix_t();
+                }
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            if(rotation) {
+                rotation_train_lda(thread_idx, dwcm, tdcm, twcm[0], tokens, n_topics, iterations, alpha, beta, seed);
+            }
+            else {
+                par_train_lda(thread_idx, dwcm, tdcm, twcm, tokens, n_topics, iterations, alpha, beta, sampler, order, seed, sharing);
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            const double seconds = elapsed.count();
+            std::cout << ((order == sweep_order::word) ? "word" : "document") << '\t'
+                      << model << '\t'
+                      << iterations << '\t' << seconds << '\t'
+                      << (static_cast<double>(n_tokens * iterations) / seconds) << std::endl;
+        }
+    }
+
+    return hpx::finalize();
+}
+
+int main(int argc, char ** argv) {
+    hpx::program_options::options_description desc("usage: ldabench [options]");
+    desc.add_options()("num_docs,nd",
+        hpx::program_options::value<std::size_t>()->default_value(10000),
+        "number of synthetic documents (default: 10000)")("doc_len,dl",
+        hpx::program_options::value<std::size_t>()->default_value(100),
+        "mean document length (default: 100)")("vocab_size,vs",
+        hpx::program_options::value<std::size_t>()->default_value(10000),
+        "vocabulary size (default: 10000)")("zipf,z",
+        hpx::program_options::value<double>()->default_value(1.0),
+        "zipf exponent of the word distribution (default: 1.0)")("num_topics,nt",
+        hpx::program_options::value<std::size_t>()->default_value(100),
+        "number of topics (default: 100)")("num_iters,n",
+        hpx::program_options::value<std::size_t>()->default_value(10),
+        "number of iterations (default: 10)")("alpha,a",
+        hpx::program_options::value<double>()->default_value(0.1),
+        "alpha parameter")("beta,b",
+        hpx::program_options::value<double>()->default_value(0.011),
+        "beta parameter")("sampler,sp",
+        hpx::program_options::value<std::string>()->default_value("dense"),
+        "sampling kernel [dense|sparse|alias] (default: dense)")("seed,sd",
+        hpx::program_options::value<std::uint64_t>()->default_value(0),
+        "random number generator seed (default: 0)")("sweep,sw",
+        hpx::program_options::value<std::string>()->default_value("both"),
+        "token sweep order [document|word|both] (default: both)")("model,md",
+        hpx::program_options::value<std::string>()->default_value("replicated"),
+        "trainer's topic-word model [replicated|shared|rotation|all] (default: replicated)")("draw_bench,db",
+        "time the dense sampler's topic-draw kernels instead of training")("draws,dr",
+        hpx::program_options::value<std::size_t>()->default_value(1000000),
+        "number of draws timed by --draw_bench (default: 1000000)");
+
+    hpx::init_params params;
+    params.desc_cmdline = desc;
+    return hpx::init(argc, argv, params);
+}
+
+#endif
@@ -19,51 +19,56 @@
 
 #include "ldalib.hpp"
 #include "gibbs.hpp"
+#include "sparse_gibbs.hpp"
+#include "alias_gibbs.hpp"
 
 using blaze::DynamicMatrix;
 using blaze::DynamicVector;
 using blaze::CompressedMatrix;
 
-void train_lda(CompressedMatrix<double> const& dwcm,
-               DynamicMatrix<double> & tdcm,
-               DynamicMatrix<double> & twcm,
-               std::vector<std::size_t> & tokens,
-               const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta) {
+void train_lda(sparse_count_matrix_t const& dwcm,
+               count_matrix_t & tdcm,
+               count_matrix_t & twcm,
+               token_topics & tokens,
+               const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+               const sampler_type sampler,
+               const std::uint64_t seed,
+               checkpoint_config const& checkpoint) {
 
-    // build randomized topic-document-count-matrix and topic-word-count-matrix
-    //
-    {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<std::size_t> dis(0, n_topics-1);
-
-        const std::size_t n_docs = dwcm.rows();
-
-        std::vector<std::size_t>::iterator token_itr = tokens.begin();
+    counter_rng rng(seed);
 
-        for(std::size_t d = 0; d < n_docs; ++d) {
-            const auto dwcm_end = dwcm.end(d);
-            for(CompressedMatrix<double, blaze::rowMajor>::ConstIterator it = dwcm.begin(d); it != dwcm_end; ++it) {
-                const std::size_t w = it->index();
-                const std::size_t k_max = static_cast<std::size_t>(std::floor(it->value()));
-                for(std::size_t k = 0; k < k_max; k++) {
-                    const std::size_t top = dis(gen);
-                    (*token_itr) = top;
-                    tdcm(top, d) += 1.0;
-                    twcm(top, w) += 1.0;
-                    ++token_itr;
-                }
-            }
-        }
+    // build randomized topic-document-count-matrix and topic-word-count-matrix,
+    // or count the topics of the checkpoint being resumed
+    //
+    if(checkpoint.first_iteration > 0) {
+        count_init(dwcm, tdcm, twcm, tokens);
     }
+    else {
+        random_init(dwcm, tdcm, twcm, tokens, rng, n_topics);
+    }
+
+    checkpoint_writer checkpoints(checkpoint, seed, n_topics, dwcm.rows());
 
-    DynamicVector<double> ztot(n_topics, 0.0);
+    count_vector_t ztot(n_topics, 0);
     DynamicVector<double> probs(n_topics, 0.0);
+    sparse_buckets buckets{};
+    alias_tables tables{};
     const double N = static_cast<double>(tokens.size());
-    drand dr{};
 
-    for(std::size_t i = 0; i < iterations; ++i) {
-        ztot = blaze::sum<blaze::rowwise>(twcm);
-        gibbs(dwcm, tdcm, twcm, tokens, ztot, probs, dr, n_topics, N, alpha, beta);
+    for(std::size_t i = checkpoint.first_iteration; i < iterations; ++i) {
+        ztot = topic_totals(twcm);
+        rng.sweep(static_cast<std::uint32_t>(i));
+        switch(sampler) {
+            case sampler_type::sparse:
+                sparse_gibbs(dwcm, tdcm, twcm, tokens, ztot, buckets, rng, n_topics, N, alpha, beta);
+                break;
+            case sampler_type::alias:
+                alias_gibbs(dwcm, tdcm, twcm, tokens, ztot, tables, rng, n_topics, N, alpha, beta);
+                break;
+            default:
+                gibbs(dwcm, tdcm, twcm, tokens, ztot, probs, rng, n_topics, N, alpha, beta);
+        }
+
+        checkpoints.iteration_done(i, iterations, tokens);
     }
 }
@@ -11,14 +11,21 @@
 #include <cstdint>
 #include <blaze/Math.h>
 
+#include "gibbs.hpp"
+#include "counts.hpp"
+#include "checkpoint.hpp"
+
 using blaze::CompressedMatrix;
 using blaze::DynamicMatrix;
 
 void train_lda(
-    CompressedMatrix<double> const& dwcm,
-    DynamicMatrix<double> & tdcm,
-    DynamicMatrix<double> & twcm,
-    std::vector<std::size_t> &tokens,
-    const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta);
+    sparse_count_matrix_t const& dwcm,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics &tokens,
+    const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+    const sampler_type sampler = sampler_type::dense,
+    const std::uint64_t seed = 0,
+    checkpoint_config const& checkpoint = checkpoint_config{});
 
 #endif
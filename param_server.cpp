@@ -0,0 +1,191 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <hpx/config.hpp>
+#include <hpx/hpx.hpp>
+#include <hpx/modules/collectives.hpp>
+
+#include <vector>
+#include <string>
+#include <numeric>
+#include <algorithm>
+#include <cstdint>
+
+#include <blaze/Math.h>
+
+#include "param_server.hpp"
+
+using namespace hpx::collectives;
+
+using topic_word_shard_component = hpx::components::component<topic_word_shard>;
+HPX_REGISTER_COMPONENT(topic_word_shard_component, topic_word_shard);
+
+HPX_REGISTER_ACTION(topic_word_shard::pull_action, topic_word_shard_pull_action);
+HPX_REGISTER_ACTION(topic_word_shard::push_action, topic_word_shard_push_action);
+HPX_REGISTER_ACTION(topic_word_shard::totals_action, topic_word_shard_totals_action);
+HPX_REGISTER_ACTION(topic_word_shard::top_words_action, topic_word_shard_top_words_action);
+
+topic_word_shard::topic_word_shard() : n_topics(0), words(), slots(), rounds(), counts(), ztot() {}
+
+topic_word_shard::topic_word_shard(const std::size_t topics, const std::size_t n_words, const std::size_t n_shards, const std::size_t shard)
+    : n_topics(topics), words(), slots(n_words, n_words), rounds(), counts(), ztot(topics, 0) {
+
+    for(std::size_t w = 0; w < n_words; ++w) {
+        if(shard_of(w, n_shards) == shard) {
+            slots[w] = words.size();
+            words.push_back(w);
+        }
+    }
+
+    rounds.assign(words.size(), 0);
+    counts.resize(n_topics, words.size());
+    counts = 0;
+}
+
+word_counts topic_word_shard::pull(std::vector<std::uint64_t> const& pulled, const std::uint64_t since) const {
+    word_counts out;
+    for(const std::uint64_t w : pulled) {
+        if(__atomic_load_n(&rounds[slots[w]], __ATOMIC_RELAXED) >= since) {
+            out.words.push_back(w);
+        }
+    }
+
+    out.counts.resize(out.words.size() * n_topics);
+
+    count_t * out_w = out.counts.data();
+    for(const std::uint64_t w : out.words) {
+        const count_t * counts_w = counts.data(slots[w]);
+        for(std::size_t t = 0; t < n_topics; ++t) {
+            out_w[t] = load_count(counts_w[t]);
+        }
+        out_w += n_topics;
+    }
+
+    return out;
+}
+
+void topic_word_shard::push(std::vector<std::uint64_t> const& pushed, delta_payload const& delta, const std::uint64_t round) {
+    for_each_delta(delta, [this, &pushed](const std::size_t j, const std::size_t t, const count_t v) {
+        add_count<true>(counts(t, slots[pushed[j]]), v);
+        add_count<true>(ztot[t], v);
+    });
+
+    // every push of a round stores the same value
+    //
+    for(const std::uint64_t w : pushed) {
+        __atomic_store_n(&rounds[slots[w]], round, __ATOMIC_RELAXED);
+    }
+}
+
+std::vector<total_t> topic_word_shard::totals() const {
+    std::vector<total_t> out(n_topics);
+    for(std::size_t t = 0; t < n_topics; ++t) {
+        out[t] = load_count(ztot[t]);
+    }
+    return out;
+}
+
+word_counts topic_word_shard::top_words(const std::size_t mxtokens) const {
+    const std::size_t n_held = words.size();
+    const std::size_t m = std::min(mxtokens, n_held);
+
+    std::vector<std::size_t> idx(n_held), columns;
+    for(std::size_t t = 0; t < n_topics; ++t) {
+        std::iota(std::begin(idx), std::end(idx), 0);
+        std::partial_sort(std::begin(idx), std::begin(idx) + m, std::end(idx), [this, t](const std::size_t a, const std::size_t b) {
+            return counts(t, a) > counts(t, b);
+        });
+        columns.insert(std::end(columns), std::begin(idx), std::begin(idx) + m);
+    }
+
+    std::sort(std::begin(columns), std::end(columns));
+    columns.erase(std::unique(std::begin(columns), std::end(columns)), std::end(columns));
+
+    std::vector<std::uint64_t> top(columns.size());
+    std::transform(std::begin(columns), std::end(columns), std::begin(top), [this](const std::size_t j) { return words[j]; });
+    return pull(top, 0);
+}
+
+topic_word_server create_topic_word_server(const std::size_t n_locales, const std::size_t locality_id, const std::size_t n_topics, const std::size_t n_words) {
+    const std::string basename = "topic_word_shard";
+
+    topic_word_server server;
+    server.n_topics = n_topics;
+    server.n_words = n_words;
+
+    hpx::id_type shard = hpx::new_<topic_word_shard>(hpx::find_here(), n_topics, n_words, n_locales, locality_id).get();
+    hpx::register_with_basename(basename, shard, locality_id).get();
+
+    std::vector< hpx::future<hpx::id_type> > shards = hpx::find_all_from_basename(basename, n_locales);
+    for(auto & s : shards) {
+        server.shards.push_back(s.get());
+    }
+
+    return server;
+}
+
+void release_topic_word_server(const std::size_t n_locales, const std::size_t locality_id, topic_word_server & server) {
+    const std::string all_reduce_release_basename = "all_reduce_release";
+    auto all_reduce_release_client = create_communicator(
+        all_reduce_release_basename.c_str(), num_sites_arg(n_locales), this_site_arg(locality_id)
+    );
+
+    hpx::collectives::all_reduce(all_reduce_release_client, std::uint64_t{0}, std::plus<std::uint64_t>{}).get();
+    server.shards.clear();
+}
+
+void server_totals(topic_word_server const& server, count_vector_t & ztot) {
+    std::vector< hpx::future< std::vector<total_t> > > totals;
+    for(const auto & shard : server.shards) {
+        totals.push_back(hpx::async<topic_word_shard::totals_action>(shard));
+    }
+
+    ztot.resize(server.n_topics);
+    ztot = 0;
+    for(auto & f : totals) {
+        const std::vector<total_t> shard_ztot = f.get();
+        for(std::size_t t = 0; t < server.n_topics; ++t) {
+            ztot[t] += shard_ztot[t];
+        }
+    }
+}
+
+void server_top_words(topic_word_server const& server, const std::size_t mxtokens, std::vector< std::vector<std::size_t> > & top, count_vector_t & ztot) {
+    const std::size_t n_topics = server.n_topics;
+
+    std::vector< hpx::future< word_counts > > candidates;
+    for(const auto & shard : server.shards) {
+        candidates.push_back(hpx::async<topic_word_shard::top_words_action>(shard, mxtokens));
+    }
+
+    server_totals(server, ztot);
+
+    // a topic's most frequent words are among the most frequent words of
+    // that topic in each shard
+    //
+    word_counts merged;
+    for(auto & f : candidates) {
+        const word_counts c = f.get();
+        merged.words.insert(std::end(merged.words), std::begin(c.words), std::end(c.words));
+        merged.counts.insert(std::end(merged.counts), std::begin(c.counts), std::end(c.counts));
+    }
+
+    const std::size_t n_candidates = merged.words.size();
+    const std::size_t m = std::min(mxtokens, n_candidates);
+
+    top.assign(n_topics, std::vector<std::size_t>{});
+    std::vector<std::size_t> idx(n_candidates);
+    for(std::size_t t = 0; t < n_topics; ++t) {
+        std::iota(std::begin(idx), std::end(idx), 0);
+        std::partial_sort(std::begin(idx), std::begin(idx) + m, std::end(idx), [&merged, n_topics, t](const std::size_t a, const std::size_t b) {
+            return merged.counts[a * n_topics + t] > merged.counts[b * n_topics + t];
+        });
+
+        for(std::size_t j = 0; j < m; ++j) {
+            top[t].push_back(static_cast<std::size_t>(merged.words[idx[j]]));
+        }
+    }
+}
@@ -0,0 +1,130 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __MINIATURIST_PARAM_SERVER_HPP__
+#define __MINIATURIST_PARAM_SERVER_HPP__
+
+#include <hpx/config.hpp>
+#include <hpx/include/actions.hpp>
+#include <hpx/include/components.hpp>
+#include <hpx/serialization/vector.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "counts.hpp"
+#include "delta_payload.hpp"
+#include "jch.hpp"
+
+// a topic-word model (twcm) sharded by word across localities
+//
+// every locality runs one topic_word_shard component holding the K x 1
+// columns of the words JumpConsistentHash routes to it (shard_of), so no
+// locality holds more than about V / n_locales of the K x V counts.
+// trainers push the differences of their sweeps and pull back the
+// columns of their words that any trainer pushed to in the same round
+// (sharded_train_lda in distparldalib.hpp)
+//
+
+// locality whose shard holds word w
+//
+inline std::size_t shard_of(const std::uint64_t w, const std::size_t n_shards) {
+    return static_cast<std::size_t>(JumpConsistentHash(w, static_cast<std::int32_t>(n_shards)));
+}
+
+// the K x 1 topic counts of some words; counts holds the column of
+// words[j] at [j * n_topics, (j+1) * n_topics)
+//
+struct word_counts {
+    std::vector<std::uint64_t> words;
+    std::vector<count_t> counts;
+
+    template<typename Archive>
+    void serialize(Archive & ar, unsigned) {
+        ar & words & counts;
+    }
+};
+
+class topic_word_shard : public hpx::components::component_base<topic_word_shard> {
+public:
+    topic_word_shard();
+
+    topic_word_shard(const std::size_t topics, const std::size_t n_words, const std::size_t n_shards, const std::size_t shard);
+
+    // counts of those of words (all held by this shard) pushed to in
+    // round since or later; since 0 returns all of them
+    //
+    word_counts pull(std::vector<std::uint64_t> const& words, const std::uint64_t since) const;
+
+    // adds delta, whose word j is words[j] (see encode_columns), to the
+    // counts and marks the words pushed to in round. pushes of several
+    // localities may run at once and add with atomic adds; rounds must
+    // not decrease
+    //
+    void push(std::vector<std::uint64_t> const& words, delta_payload const& delta, const std::uint64_t round);
+
+    // topic totals of this shard's words
+    //
+    std::vector<total_t> totals() const;
+
+    // counts of the union of every topic's mxtokens most frequent words
+    // in this shard
+    //
+    word_counts top_words(const std::size_t mxtokens) const;
+
+    HPX_DEFINE_COMPONENT_ACTION(topic_word_shard, pull);
+    HPX_DEFINE_COMPONENT_ACTION(topic_word_shard, push);
+    HPX_DEFINE_COMPONENT_ACTION(topic_word_shard, totals);
+    HPX_DEFINE_COMPONENT_ACTION(topic_word_shard, top_words);
+
+private:
+    std::size_t n_topics;
+
+    // words held, in increasing order; word words[j] is column j of
+    // counts, slots[w] is the column of word w and rounds[j] the last
+    // round column j was pushed to
+    //
+    std::vector<std::uint64_t> words;
+    std::vector<std::size_t> slots;
+    std::vector<std::uint64_t> rounds;
+    count_matrix_t counts;
+    count_vector_t ztot;
+};
+
+HPX_REGISTER_ACTION_DECLARATION(topic_word_shard::pull_action, topic_word_shard_pull_action);
+HPX_REGISTER_ACTION_DECLARATION(topic_word_shard::push_action, topic_word_shard_push_action);
+HPX_REGISTER_ACTION_DECLARATION(topic_word_shard::totals_action, topic_word_shard_totals_action);
+HPX_REGISTER_ACTION_DECLARATION(topic_word_shard::top_words_action, topic_word_shard_top_words_action);
+
+// every locality's shard; shards[i] is the shard of locality i
+//
+struct topic_word_server {
+    std::size_t n_topics;
+    std::size_t n_words;
+    std::vector<hpx::id_type> shards;
+};
+
+// creates this locality's shard and finds the others; called on every
+// locality
+//
+topic_word_server create_topic_word_server(const std::size_t n_locales, const std::size_t locality_id, const std::size_t n_topics, const std::size_t n_words);
+
+// waits until every locality is done with the shards, then releases this
+// locality's references to them; called on every locality
+//
+void release_topic_word_server(const std::size_t n_locales, const std::size_t locality_id, topic_word_server & server);
+
+// topic totals of the whole model
+//
+void server_totals(topic_word_server const& server, count_vector_t & ztot);
+
+// every topic's mxtokens most frequent words, most frequent first, and the
+// topic totals of the whole model
+//
+void server_top_words(topic_word_server const& server, const std::size_t mxtokens, std::vector< std::vector<std::size_t> > & top, count_vector_t & ztot);
+
+#endif
@@ -27,6 +27,9 @@
 #include "inverted_index.hpp"
 #include "documents.hpp"
 #include "results.hpp"
+#include "rebalance.hpp"
+#include "shard_placement.hpp"
+#include "checkpoint.hpp"
 
 namespace fs = std::experimental::filesystem;
 using namespace hpx::collectives;
@@ -75,51 +78,202 @@ int hpx_main(hpx::program_options::variables_map & vm) {
     const double alpha = vm["alpha"].as<double>();
     const double beta = vm["beta"].as<double>();
 
+    sampler_type sampler = sampler_type::dense;
+    if(!sampler_from_string(vm["sampler"].as<std::string>(), sampler)) {
+        std::cerr << "Please specify '--sampler=[dense|sparse|alias]'" << std::endl;
+        return hpx::finalize();
+    }
+
+    const std::uint64_t seed = vm["seed"].as<std::uint64_t>();
+
+    const bool numa_report = (vm.count("numa_report") > 0);
+
+    const double rebalance = vm["rebalance"].as<double>();
+    if(rebalance < 0.0) {
+        std::cerr << "Please specify '--rebalance=non-negative-value'" << std::endl;
+        return hpx::finalize();
+    }
+
+    sweep_order order = sweep_order::document;
+    if(!sweep_order_from_string(vm["sweep"].as<std::string>(), order)) {
+        std::cerr << "Please specify '--sweep=[document|word]'" << std::endl;
+        return hpx::finalize();
+    }
+
+    if(order == sweep_order::word && sampler != sampler_type::dense) {
+        std::cerr << "'--sweep=word' requires '--sampler=dense'" << std::endl;
+        return hpx::finalize();
+    }
+
+    // rotation is a trainer of its own (rotation_train_lda) rather than a
+    // model_sharing mode of par_train_lda
+    //
+    model_sharing sharing = model_sharing::replicated;
+    const bool rotation = (vm["model"].as<std::string>() == "rotation");
+    if(!rotation && !model_sharing_from_string(vm["model"].as<std::string>(), sharing)) {
+        std::cerr << "Please specify '--model=[replicated|shared|rotation]'" << std::endl;
+        return hpx::finalize();
+    }
+
+    if(rotation && sampler != sampler_type::dense) {
+        std::cerr << "'--model=rotation' requires '--sampler=dense'" << std::endl;
+        return hpx::finalize();
+    }
+
+    // the sparse sampler indexes each word's topics per thread, which
+    // other threads' updates of a shared model would leave stale
+    //
+    if(sharing == model_sharing::shared && sampler == sampler_type::sparse) {
+        std::cerr << "'--model=shared' does not support '--sampler=sparse'" << std::endl;
+        return hpx::finalize();
+    }
+
+    if(rotation && rebalance > 0.0) {
+        std::cerr << "'--model=rotation' does not support '--rebalance'" << std::endl;
+        return hpx::finalize();
+    }
+
+    // stale synchronous training (ssp_train_lda) runs on replicas; shards
+    // run their iterations independently, so their documents can't move
+    //
+    const bool stale = (vm.count("staleness") > 0);
+    if(stale && (rotation || sharing != model_sharing::replicated)) {
+        std::cerr << "'--staleness' requires '--model=replicated'" << std::endl;
+        return hpx::finalize();
+    }
+
+    if(stale && rebalance > 0.0) {
+        std::cerr << "'--staleness' does not support '--rebalance'" << std::endl;
+        return hpx::finalize();
+    }
+
+    // checkpoints hold the topics of every token at the end of an
+    // iteration (checkpoint.hpp); ssp shards are at different iterations
+    //
+    checkpoint_config checkpoint;
+    if(vm.count("checkpoint") > 0) {
+        checkpoint.path = vm["checkpoint"].as<std::string>();
+    }
+    checkpoint.every = vm["checkpoint_every"].as<std::size_t>();
+
+    const bool resume = (vm.count("resume") > 0);
+    if(resume && checkpoint.path.size() < 1) {
+        std::cerr << "'--resume' requires '--checkpoint=checkpoint-file'" << std::endl;
+        return hpx::finalize();
+    }
+
+    if(stale && checkpoint.path.size() > 0) {
+        std::cerr << "'--staleness' does not support '--checkpoint'" << std::endl;
+        return hpx::finalize();
+    }
+
     std::unordered_map<std::string, std::size_t> vocabulary;
 
     fs::path wpth{vm["vocab_list"].as<std::string>()};
 
     const std::size_t vocab_sz = load_wordlist(wpth, vocabulary);
 
-    std::vector< CompressedMatrix<double> > dwcm(n_threads);
-    std::vector< DynamicMatrix<double> > tdcm(n_threads), twcm(n_threads);
+    std::vector< sparse_count_matrix_t > dwcm(n_threads);
+    std::vector< count_matrix_t > tdcm(n_threads), twcm(n_threads);
 
     std::vector< std::size_t > thread_idx(n_threads);
     std::iota(std::begin(thread_idx), std::end(thread_idx), 0);
-    std::vector< std::vector<std::size_t> > tokens(n_threads);
+    std::vector< token_topics > tokens(n_threads);
     std::vector< std::tuple<std::size_t, std::size_t> > doc_chunks(n_threads);
 
     {
         std::vector< fs::path > paths;
         const std::size_t n_paths = path_to_vector( pth, paths );
-        const std::size_t chunk_sz = n_paths / n_threads;
 
-        std::vector< fs::path >::iterator paths_itr = paths.begin();
-        std::vector< inverted_index_t > ii(n_threads);
+        // index the corpus once, then split the documents into contiguous
+        // shards holding about the same number of tokens; equal document
+        // counts leave the shard with the longest documents as the
+        // straggler every iteration
+        //
+        sparse_count_matrix_t corpus_dwcm;
+        {
+            std::vector< fs::path >::iterator beg = paths.begin();
+            std::vector< fs::path >::iterator end = paths.end();
+            inverted_index_t ii;
+            document_path_to_inverted_index(beg, end, regexp, ii, vocabulary);
+            inverted_index_to_matrix(vocabulary, ii, n_paths, corpus_dwcm);
+            corpus_dwcm = blaze::trans(corpus_dwcm);
+        }
 
-        for(const std::size_t i : thread_idx) {
-            const std::size_t base = i * chunk_sz;
-            std::tuple<std::size_t, std::size_t> dp{base,  ( i != (n_threads-1) ) ? (base + chunk_sz) : (n_paths-1) };
+        std::vector< std::size_t > doc_lens(n_paths), bounds;
+        for(std::size_t d = 0; d < n_paths; ++d) {
+            doc_lens[d] = doc_tokens(corpus_dwcm, d);
+        }
+
+        balanced_partition(doc_lens, n_threads, bounds);
+
+        // each shard's state is allocated and first touched by the worker
+        // that will sample it (shard_placement.hpp)
+        //
+        for_each_shard(thread_idx, [&](const std::size_t i) {
+            copy_rows(corpus_dwcm, bounds[i], bounds[i+1], dwcm[i]);
+            doc_chunks[i] = std::make_tuple(bounds[i], bounds[i+1]);
+
+            tdcm[i].resize( n_topics, bounds[i+1] - bounds[i] );
+            tdcm[i] = 0;
+
+            // shared and rotation models only use twcm[0]
+            //
+            if(i == 0 || (sharing == model_sharing::replicated && !rotation)) {
+                twcm[i].resize( n_topics, vocab_sz );
+                twcm[i] = 0;
+            }
+
+            matrix_to_vector(dwcm[i], tokens[i], n_topics);
+
+            if(numa_report) {
+                report_placement("parlda", i, shard_state_regions(dwcm[i], tdcm[i], twcm[i], tokens[i]));
+            }
+        });
+    }
+
+    // with --resume the tokens take the topics of the newest checkpoint
+    // and training continues after its iteration
+    //
+    if(resume) {
+        training_checkpoint resumed;
+        if(!read_latest_checkpoint(checkpoint.path, resumed)) {
+            std::cerr << "Could not read a checkpoint from '" << checkpoint.path << "'" << std::endl;
+            return hpx::finalize();
+        }
 
-            const std::size_t doc_diff = std::get<1>(dp)-std::get<0>(dp);
-            tdcm[i].resize( n_topics, doc_diff );
-            twcm[i].resize( n_topics, vocab_sz );
-            tdcm[i] = 0.0;
-            twcm[i] = 0.0;
+        if(resumed.seed != seed || !restore_checkpoint(resumed, n_topics, shard_documents(thread_idx, dwcm), thread_idx, tokens)) {
+            std::cerr << "The checkpoint '" << checkpoint.path << "' was taken with a different corpus, seed or number of topics" << std::endl;
+            return hpx::finalize();
+        }
 
-            doc_chunks[i] = std::move(dp);
+        checkpoint.first_iteration = static_cast<std::size_t>(resumed.iterations);
+    }
 
-            auto beg = paths_itr+std::get<0>(doc_chunks[i]);
-            auto end = paths_itr+std::get<1>(doc_chunks[i]);
-            document_path_to_inverted_index(beg, end, regexp, ii[i], vocabulary);
-            const std::size_t ndocs = static_cast<std::size_t>(end-beg);
-            inverted_index_to_matrix(vocabulary, ii[i], ndocs, dwcm[i]);
-            dwcm[i] = blaze::trans(dwcm[i]);
-            matrix_to_vector(dwcm[i], tokens[i]);
-	}
+    if(rotation) {
+        rotation_train_lda(thread_idx, dwcm, tdcm, twcm[0], tokens, n_topics, iterations, alpha, beta, seed, checkpoint);
     }
+    else if(stale) {
+        ssp_train_lda(thread_idx, dwcm, tdcm, twcm, tokens, n_topics, iterations, alpha, beta, vm["staleness"].as<std::size_t>(), sampler, order, seed);
+    }
+    else {
+        par_train_lda(thread_idx, dwcm, tdcm, twcm, tokens, n_topics, iterations, alpha, beta, sampler, order, seed, sharing, rebalance, checkpoint);
 
-    par_train_lda(thread_idx, dwcm, tdcm, twcm, tokens, n_topics, iterations, alpha, beta);
+        // rebalancing may have moved the shards' boundaries
+        //
+        std::vector< std::size_t > bounds;
+        shard_bounds(thread_idx, dwcm, bounds);
+        for(const std::size_t i : thread_idx) {
+            doc_chunks[i] = std::make_tuple(bounds[i], bounds[i+1]);
+        }
+    }
+
+    // the replicas of a shared or rotation model were never sized; drop
+    // them from the output
+    //
+    if(rotation || sharing == model_sharing::shared) {
+        twcm.resize(1);
+    }
 
     if(jsonprefix.size() < 1) {
 
@@ -150,7 +304,25 @@ int main(int argc, char ** argv) {
         hpx::program_options::value<double>()->default_value(0.1),
         "alpha parameter")("beta,b",
         hpx::program_options::value<double>()->default_value(0.011),
-        "beta parameter")("num_topics,nt",
+        "beta parameter")("sampler,sp",
+        hpx::program_options::value<std::string>()->default_value("dense"),
+        "sampling kernel [dense|sparse|alias] (default: dense)")("seed,sd",
+        hpx::program_options::value<std::uint64_t>()->default_value(0),
+        "random number generator seed (default: 0)")("numa_report,nr",
+        "print the worker and NUMA node of each thread and of its state to stderr")("staleness,ss",
+        hpx::program_options::value<std::size_t>(),
+        "train without a barrier per iteration; threads sample against a model at most this many iterations old (requires --model=replicated)")("rebalance,rb",
+        hpx::program_options::value<double>()->default_value(0.0),
+        "move documents between threads when the slowest thread's sweep takes more than (1 + value) times the mean, 0 disables (default: 0)")("sweep,sw",
+        hpx::program_options::value<std::string>()->default_value("document"),
+        "token sweep order [document|word] (default: document)")("checkpoint,ck",
+        hpx::program_options::value<std::string>(),
+        "file the topic of every token is saved to, in the background, after the last iteration and every '--checkpoint_every' iterations")("checkpoint_every,ce",
+        hpx::program_options::value<std::size_t>()->default_value(0),
+        "iterations between checkpoints, 0 only saves after the last iteration (default: 0)")("resume,rs",
+        "continue training from the newest checkpoint at '--checkpoint'")("model,md",
+        hpx::program_options::value<std::string>()->default_value("replicated"),
+        "topic-word model per thread, shared by all threads, or split into vocabulary blocks rotated between threads [replicated|shared|rotation] (default: replicated)")("num_topics,nt",
         hpx::program_options::value<std::size_t>(),
         "number of topics")("vocab_list,vl",
         hpx::program_options::value<std::string>(),
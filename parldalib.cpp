@@ -11,13 +11,23 @@
 #include <hpx/algorithm.hpp>
 
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <iostream>
 #include <cstdint>
 
 #include <unicode/unistr.h>
 #include <blaze/Math.h>
 
 #include "gibbs.hpp"
+#include "sparse_gibbs.hpp"
+#include "alias_gibbs.hpp"
+#include "column_reduce.hpp"
+#include "rebalance.hpp"
+#include "shard_placement.hpp"
+#include "checkpoint.hpp"
 
 using namespace hpx;
 
@@ -25,59 +35,430 @@ using blaze::DynamicMatrix;
 using blaze::DynamicVector;
 using blaze::CompressedMatrix;
 
+// counter_rng streams are keyed by global token position; shard i
+// starts after the tokens of shards [0, i)
+//
+static void shard_rngs(std::vector<std::size_t> const& thread_idx, std::vector< token_topics > const& tokens, const std::uint64_t seed, std::vector< counter_rng > & rngs) {
+    std::uint64_t offset = 0;
+    for(const std::size_t i : thread_idx) {
+        rngs.emplace_back(seed, offset);
+        offset += tokens[i].size();
+    }
+}
+
+// adds every thread's change of its ztot copy (all of which started out
+// equal to ztot_base) into ztot_base
+//
+static void merge_ztot(std::vector<std::size_t> const& thread_idx, std::vector< count_vector_t > const& ztot, count_vector_t & ztot_base) {
+    const std::size_t n_topics = ztot_base.size();
+    for(std::size_t t = 0; t < n_topics; ++t) {
+        total_t dztot = 0;
+        for(const std::size_t ti : thread_idx) {
+            dztot += ztot[ti][t] - ztot_base[t];
+        }
+        ztot_base[t] += dztot;
+    }
+}
+
+// runs rebalance_shards after a sweep and rebuilds the counter_rng
+// streams and word orders of the shards it changed
+//
+static void rebalance_step(const std::size_t iteration, const std::size_t iterations,
+                   std::vector<std::size_t> const& thread_idx,
+                   std::vector<double> const& seconds,
+                   const double tolerance,
+                   std::vector< sparse_count_matrix_t > & dwcm,
+                   std::vector< count_matrix_t > & tdcm,
+                   std::vector< token_topics > & tokens,
+                   std::vector< counter_rng > & rngs,
+                   std::vector< word_order > & orders,
+                   std::vector< sparse_buckets > & buckets,
+                   const sweep_order order,
+                   const std::uint64_t seed,
+                   const std::size_t n_words,
+                   bool & pending) {
+
+    const std::vector<std::size_t> moved = rebalance_shards("parlda", iteration, iterations, thread_idx, seconds, tolerance, dwcm, tdcm, tokens, run_on_shards, pending);
+    if(moved.empty()) {
+        return;
+    }
+
+    rngs.clear();
+    shard_rngs(thread_idx, tokens, seed, rngs);
+
+    for(const std::size_t ti : moved) {
+        reset_word_topics(buckets[ti]);
+    }
+
+    if(order == sweep_order::word) {
+        for_each_shard(moved, [&dwcm, &orders, n_words](const std::size_t ti) {
+            build_word_order(dwcm[ti], n_words, orders[ti]);
+        });
+    }
+}
+
+// model_sharing::shared; every thread samples against the one twcm and
+// updates it with atomic adds, so there are no per-thread copies to
+// subtract, reduce and copy back after each sweep. ztot is still a
+// per-thread copy; every sweep starts from ztot_base and the threads'
+// changes are folded back into it (merge_ztot), as the replicated
+// trainer does
+//
+static void shared_par_train_lda(const std::vector<std::size_t> & thread_idx,
+                   std::vector< sparse_count_matrix_t > & dwcm,
+                   std::vector< count_matrix_t > & tdcm,
+                   count_matrix_t & twcm,
+                   std::vector< token_topics > & tokens,
+                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+                   const sampler_type sampler,
+                   const sweep_order order,
+                   const std::uint64_t seed,
+                   const double rebalance,
+                   checkpoint_config const& checkpoint) {
+
+    // sparse_gibbs keeps a per-thread index of each word's topics that
+    // other threads' adds would leave stale (sparse_gibbs.hpp)
+    //
+    if(sampler == sampler_type::sparse) {
+        std::cerr << "parlda: the shared model does not support the sparse sampler" << std::endl;
+        return;
+    }
+
+    const std::size_t n_threads = thread_idx.size();
+
+    std::vector< counter_rng > rngs;
+    shard_rngs(thread_idx, tokens, seed, rngs);
+
+    const bool resumed = (checkpoint.first_iteration > 0);
+    for_each_shard(thread_idx, [&dwcm, &tdcm, &twcm, &tokens, &rngs, n_topics, resumed](const std::size_t i) {
+        if(resumed) {
+            count_init(dwcm[i], tdcm[i], twcm, tokens[i], model_sharing::shared);
+        }
+        else {
+            random_init(dwcm[i], tdcm[i], twcm, tokens[i], rngs[i], n_topics, model_sharing::shared);
+        }
+    });
+
+    checkpoint_writer checkpoints(checkpoint, seed, n_topics, shard_documents(thread_idx, dwcm));
+
+    std::vector< count_vector_t > ztot(n_threads);
+    std::vector< DynamicVector<double> > probs(n_threads);
+    std::vector< sparse_buckets > buckets(n_threads);
+    std::vector< alias_tables > tables(n_threads);
+    std::vector< word_order > orders(n_threads);
+
+    for_each_shard(thread_idx, [&dwcm, &twcm, &ztot, &probs, &orders, n_topics, order](const std::size_t ti) {
+        ztot[ti].resize(n_topics);
+        probs[ti].resize(n_topics);
+        ztot[ti] = 0;
+        probs[ti] = 0.0;
+
+        if(order == sweep_order::word) {
+            build_word_order(dwcm[ti], twcm.columns(), orders[ti]);
+        }
+    });
+
+    double N = 0.0;
+    {
+        std::size_t Nsz = 0;
+        for(const auto& t : tokens) {
+            Nsz += t.size();
+        }
+
+        N = static_cast<double>(Nsz);
+    }
+
+    // sampling time of each shard's last sweep; drives rebalance_shards
+    // when rebalance (the tolerated imbalance) is above zero
+    //
+    std::vector<double> seconds(n_threads, 0.0);
+    bool rebalanced = false;
+
+    // topic totals of twcm; only the sweeps change twcm, and each thread
+    // tracks its own changes in ztot[ti]
+    //
+    count_vector_t ztot_base = topic_totals(twcm);
+
+    for(std::size_t i = checkpoint.first_iteration; i < iterations; ++i) {
+        std::fill(std::begin(ztot), std::end(ztot), ztot_base);
+
+        for(const std::size_t ti : thread_idx) {
+            rngs[ti].sweep(static_cast<std::uint32_t>(i));
+        }
+
+        for_each_shard(thread_idx, [&tokens, &dwcm, &tdcm, &twcm, &ztot, &probs, &buckets, &tables, &orders, &rngs, &seconds, n_topics, alpha, beta, N, sampler, order](const std::size_t i) {
+            const auto start = std::chrono::steady_clock::now();
+
+            switch(sampler) {
+                case sampler_type::alias:
+                    alias_gibbs(dwcm[i], tdcm[i], twcm, tokens[i], ztot[i], tables[i], rngs[i], n_topics, N, alpha, beta, model_sharing::shared);
+                    break;
+                default:
+                    if(order == sweep_order::word) {
+                        gibbs_words(orders[i], tdcm[i], twcm, tokens[i], ztot[i], probs[i], rngs[i], n_topics, N, alpha, beta, model_sharing::shared);
+                    }
+                    else {
+                        gibbs(dwcm[i], tdcm[i], twcm, tokens[i], ztot[i], probs[i], rngs[i], n_topics, N, alpha, beta, model_sharing::shared);
+                    }
+            }
+
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            seconds[i] = elapsed.count();
+        });
+
+        merge_ztot(thread_idx, ztot, ztot_base);
+
+        if(rebalance > 0.0) {
+            rebalance_step(i, iterations, thread_idx, seconds, rebalance, dwcm, tdcm, tokens, rngs, orders, buckets, order, seed, twcm.columns(), rebalanced);
+        }
+
+        checkpoints.iteration_done(i, iterations, thread_idx, tokens);
+    }
+}
+
 void par_train_lda(const std::vector<std::size_t> & thread_idx,
-                   std::vector< CompressedMatrix<double> > const& dwcm,
-                   std::vector< DynamicMatrix<double> > & tdcm,
-                   std::vector< DynamicMatrix<double> > & twcm,
-                   std::vector< std::vector<std::size_t> > & tokens,
-                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta) {
+                   std::vector< sparse_count_matrix_t > & dwcm,
+                   std::vector< count_matrix_t > & tdcm,
+                   std::vector< count_matrix_t > & twcm,
+                   std::vector< token_topics > & tokens,
+                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+                   const sampler_type sampler,
+                   const sweep_order order,
+                   const std::uint64_t seed,
+                   const model_sharing sharing,
+                   const double rebalance,
+                   checkpoint_config const& checkpoint) {
+
+    if(sharing == model_sharing::shared) {
+        shared_par_train_lda(thread_idx, dwcm, tdcm, twcm[0], tokens, n_topics, iterations, alpha, beta, sampler, order, seed, rebalance, checkpoint);
+        return;
+    }
 
     const std::size_t n_threads = thread_idx.size();
 
+    std::vector< counter_rng > rngs;
+    shard_rngs(thread_idx, tokens, seed, rngs);
+
     // build randomized topic-document-count-matrix and topic-word-count-matrix
+    // (or count the topics of the checkpoint being resumed); each shard has
+    // its own tdcm, twcm and rng stream so shards initialize in parallel
+    //
+    const bool resumed = (checkpoint.first_iteration > 0);
+    for_each_shard(thread_idx, [&dwcm, &tdcm, &twcm, &tokens, &rngs, n_topics, resumed](const std::size_t i) {
+        if(resumed) {
+            count_init(dwcm[i], tdcm[i], twcm[i], tokens[i]);
+        }
+        else {
+            random_init(dwcm[i], tdcm[i], twcm[i], tokens[i], rngs[i], n_topics);
+        }
+    });
+
+    checkpoint_writer checkpoints(checkpoint, seed, n_topics, shard_documents(thread_idx, dwcm));
+
+    std::vector< count_vector_t > ztot(n_threads);
+    std::vector< DynamicVector<double> > probs(n_threads);
+    std::vector< sparse_buckets > buckets(n_threads);
+    std::vector< alias_tables > tables(n_threads);
+    std::vector< word_order > orders(n_threads);
+
+    // sum the initial replicas and copy the sum back into each of them,
+    // in parallel over column blocks (column_reduce.hpp)
     //
+    count_matrix_t twcm_base(twcm[0].rows(), twcm[0].columns());
+    column_block_reduce(thread_idx, twcm, twcm_base, 4 * n_threads);
+    column_block_broadcast(thread_idx, twcm_base, twcm, 4 * n_threads);
+
+    for_each_shard(thread_idx, [&ztot, &probs, n_topics](const std::size_t ti) {
+        ztot[ti].resize(n_topics);
+        probs[ti].resize(n_topics);
+        ztot[ti] = 0;
+        probs[ti] = 0.0;
+    });
+
+    if(order == sweep_order::word) {
+        for_each_shard(thread_idx, [&dwcm, &twcm, &orders](const std::size_t i) {
+            build_word_order(dwcm[i], twcm[i].columns(), orders[i]);
+        });
+    }
+
+    double N = 0.0;
     {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<std::size_t> dis(0, n_topics-1);
+        std::size_t Nsz = 0;
+        for(const auto& t : tokens) {
+            Nsz += t.size();
+        }
 
-        for(const std::size_t i : thread_idx) {
-            const std::size_t n_docs = dwcm[i].rows();
+        N = static_cast<double>(Nsz);
+    }
 
-            std::vector<std::size_t>::iterator token_itr = tokens[i].begin();
+    // words whose column each thread changed in the current sweep, and
+    // their union
+    //
+    std::vector< dirty_words > dirty(n_threads);
+    dirty_words changed;
+    for(const std::size_t ti : thread_idx) {
+        dirty[ti].resize(twcm_base.columns());
+    }
+    changed.resize(twcm_base.columns());
 
-            for(std::size_t d = 0; d < n_docs; ++d) {
-                //for(std::size_t w = 0; w < n_words; w++) {
-                const auto dwcm_end = dwcm[i].end(d);
-                for(CompressedMatrix<double, blaze::rowMajor>::ConstIterator it = dwcm[i].begin(d); it != dwcm_end; ++it) {
-                    const std::size_t w = it->index();
-                    const std::size_t k_max = static_cast<std::size_t>(std::floor(it->value()));
-                    for(std::size_t k = 0; k < k_max; k++) {
-                        const std::size_t top = dis(gen);
-                        (*token_itr) = top;
-                        tdcm[i](top, d) += 1.0;
-                        twcm[i](top, w) += 1.0;
-                        ++token_itr;
+    // topic totals of twcm_base; kept up to date from the threads' ztot
+    // instead of summing twcm_base every iteration
+    //
+    count_vector_t ztot_base = topic_totals(twcm_base);
+
+    // sampling time of each shard's last sweep; drives rebalance_shards
+    // when rebalance (the tolerated imbalance) is above zero
+    //
+    std::vector<double> seconds(n_threads, 0.0);
+    bool rebalanced = false;
+
+    for(std::size_t i = checkpoint.first_iteration; i < iterations; ++i) {
+        std::fill(std::begin(ztot), std::end(ztot), ztot_base);
+
+        for(const std::size_t ti : thread_idx) {
+            rngs[ti].sweep(static_cast<std::uint32_t>(i));
+        }
+
+        for_each_shard(thread_idx, [&tokens, &dwcm, &tdcm, &twcm, &ztot, &probs, &buckets, &tables, &orders, &rngs, &dirty, &seconds, n_topics, alpha, beta, N, sampler, order](const std::size_t i) {
+            const auto start = std::chrono::steady_clock::now();
+
+            switch(sampler) {
+                case sampler_type::sparse:
+                    sparse_gibbs(dwcm[i], tdcm[i], twcm[i], tokens[i], ztot[i], buckets[i], rngs[i], n_topics, N, alpha, beta, &dirty[i]);
+                    break;
+                case sampler_type::alias:
+                    alias_gibbs(dwcm[i], tdcm[i], twcm[i], tokens[i], ztot[i], tables[i], rngs[i], n_topics, N, alpha, beta, model_sharing::replicated, &dirty[i]);
+                    break;
+                default:
+                    if(order == sweep_order::word) {
+                        gibbs_words(orders[i], tdcm[i], twcm[i], tokens[i], ztot[i], probs[i], rngs[i], n_topics, N, alpha, beta, model_sharing::replicated, &dirty[i]);
+                    }
+                    else {
+                        gibbs(dwcm[i], tdcm[i], twcm[i], tokens[i], ztot[i], probs[i], rngs[i], n_topics, N, alpha, beta, model_sharing::replicated, &dirty[i]);
+                    }
+            }
+
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            seconds[i] = elapsed.count();
+        });
+
+        // a replica's clean columns still equal twcm_base, so only the
+        // changed columns are merged and copied back; late iterations,
+        // where few tokens move, cost in proportion to what moved
+        //
+        for(const std::size_t ti : thread_idx) {
+            for(const std::size_t w : dirty[ti].words) {
+                changed.mark(w);
+            }
+        }
+
+        hpx::for_each(hpx::execution::par, std::begin(changed.words), std::end(changed.words), [&thread_idx, &twcm, &twcm_base, &dirty, n_topics](const std::size_t w) {
+            count_t * base_w = twcm_base.data(w);
+
+            // replica columns hold their thread's delta after the first
+            // pass; they are overwritten with the merged column below
+            //
+            for(const std::size_t ti : thread_idx) {
+                if(dirty[ti].flags[w] != 0) {
+                    count_t * twcm_w = twcm[ti].data(w);
+                    for(std::size_t t = 0; t < n_topics; ++t) {
+                        twcm_w[t] -= base_w[t];
+                    }
+                }
+            }
+
+            for(const std::size_t ti : thread_idx) {
+                if(dirty[ti].flags[w] != 0) {
+                    const count_t * twcm_w = twcm[ti].data(w);
+                    for(std::size_t t = 0; t < n_topics; ++t) {
+                        base_w[t] += twcm_w[t];
                     }
                 }
             }
+        });
+
+        merge_ztot(thread_idx, ztot, ztot_base);
+
+        for_each_shard(thread_idx, [&twcm, &twcm_base, &changed, &dirty, &buckets, n_topics](const std::size_t ti) {
+            for(const std::size_t w : changed.words) {
+                std::copy_n(twcm_base.data(w), n_topics, twcm[ti].data(w));
+            }
+            refresh_word_topics(buckets[ti], twcm[ti], changed.words);
+            dirty[ti].clear();
+        });
+
+        changed.clear();
+
+        // replicas are equal again, so only the shards' documents move
+        //
+        if(rebalance > 0.0) {
+            rebalance_step(i, iterations, thread_idx, seconds, rebalance, dwcm, tdcm, tokens, rngs, orders, buckets, order, seed, twcm_base.columns(), rebalanced);
         }
+
+        checkpoints.iteration_done(i, iterations, thread_idx, tokens);
     }
+}
 
-    std::plus< DynamicMatrix<double> > adder{};
-    std::vector< DynamicVector<double> > ztot(n_threads);
-    std::vector< DynamicVector<double> > probs(n_threads);
-    std::vector< drand > drands(n_threads);
+void rotation_train_lda(const std::vector<std::size_t> & thread_idx,
+                   std::vector< sparse_count_matrix_t > const& dwcm,
+                   std::vector< count_matrix_t > & tdcm,
+                   count_matrix_t & twcm,
+                   std::vector< token_topics > & tokens,
+                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+                   const std::uint64_t seed,
+                   checkpoint_config const& checkpoint) {
 
-    DynamicMatrix<double> twcm_base(twcm[0].rows(), twcm[0].columns(), 0.0); 
-    twcm_base = hpx::reduce(std::begin(twcm), std::end(twcm), twcm_base, adder);
+    const std::size_t n_threads = thread_idx.size();
+    const std::size_t n_words = twcm.columns();
 
-    for(const std::size_t ti : thread_idx) {
-        twcm[ti] = twcm_base;
+    std::vector< counter_rng > rngs;
+    shard_rngs(thread_idx, tokens, seed, rngs);
+
+    // shards initialize concurrently into the one twcm
+    //
+    const bool resumed = (checkpoint.first_iteration > 0);
+    for_each_shard(thread_idx, [&dwcm, &tdcm, &twcm, &tokens, &rngs, n_topics, resumed](const std::size_t i) {
+        if(resumed) {
+            count_init(dwcm[i], tdcm[i], twcm, tokens[i], model_sharing::shared);
+        }
+        else {
+            random_init(dwcm[i], tdcm[i], twcm, tokens[i], rngs[i], n_topics, model_sharing::shared);
+        }
+    });
+
+    checkpoint_writer checkpoints(checkpoint, seed, n_topics, shard_documents(thread_idx, dwcm));
+
+    std::vector< count_vector_t > ztot(n_threads);
+    std::vector< DynamicVector<double> > probs(n_threads);
+    std::vector< word_order > orders(n_threads);
+
+    for_each_shard(thread_idx, [&dwcm, &ztot, &probs, &orders, n_topics, n_words](const std::size_t ti) {
         ztot[ti].resize(n_topics);
         probs[ti].resize(n_topics);
-        ztot[ti] = 0.0;
         probs[ti] = 0.0;
+        build_word_order(dwcm[ti], n_words, orders[ti]);
+    });
+
+    // word block b is [block_first[b], block_first[b+1]); blocks hold about
+    // the same number of tokens so the rounds stay balanced
+    //
+    std::vector< std::size_t > block_first(n_threads+1, n_words);
+    {
+        std::size_t n_tokens = 0;
+        for(const std::size_t ti : thread_idx) {
+            n_tokens += orders[ti].offsets[n_words];
+        }
+
+        block_first[0] = 0;
+        std::size_t b = 1, seen = 0;
+        for(std::size_t w = 0; w < n_words && b < n_threads; ++w) {
+            for(const std::size_t ti : thread_idx) {
+                seen += orders[ti].offsets[w+1] - orders[ti].offsets[w];
+            }
+            if((seen * n_threads) >= (b * n_tokens)) {
+                block_first[b++] = w + 1;
+            }
+        }
     }
 
     double N = 0.0;
@@ -90,19 +471,237 @@ void par_train_lda(const std::vector<std::size_t> & thread_idx,
         N = static_cast<double>(Nsz);
     }
 
-    for(std::size_t i = 0; i < iterations; ++i) {
-        ztot[0] = blaze::sum<blaze::rowwise>(twcm_base);
-        std::fill(std::begin(ztot), std::end(ztot), ztot[0]);
+    count_vector_t ztot_base = topic_totals(twcm);
 
-        hpx::for_each(hpx::execution::par, std::begin(thread_idx), std::end(thread_idx), [&tokens, &dwcm, &tdcm, &twcm, &twcm_base, &ztot, &probs, &drands, n_topics, alpha, beta, N](const std::size_t i) {
-            gibbs(dwcm[i], tdcm[i], twcm[i], tokens[i], ztot[i], probs[i], drands[i], n_topics, N, alpha, beta);
-            twcm[i] -= twcm_base;
-        });
+    for(std::size_t i = checkpoint.first_iteration; i < iterations; ++i) {
+        for(const std::size_t ti : thread_idx) {
+            rngs[ti].sweep(static_cast<std::uint32_t>(i));
+        }
+
+        // in round r shard ti samples its tokens of word block
+        // (ti + r) mod n_threads; no two shards hold the same block, so
+        // twcm needs neither replicas nor atomics. only the topic totals
+        // are shared, merged after every round
+        //
+        for(std::size_t r = 0; r < n_threads; ++r) {
+            std::fill(std::begin(ztot), std::end(ztot), ztot_base);
+
+            for_each_shard(thread_idx, [&tokens, &tdcm, &twcm, &ztot, &probs, &orders, &rngs, &block_first, r, n_threads, n_topics, alpha, beta, N](const std::size_t ti) {
+                const std::size_t b = (ti + r) % n_threads;
+                gibbs_word_block(orders[ti], block_first[b], block_first[b+1], tdcm[ti], twcm, tokens[ti], ztot[ti], probs[ti], rngs[ti], n_topics, N, alpha, beta);
+            });
+
+            merge_ztot(thread_idx, ztot, ztot_base);
+        }
+
+        checkpoints.iteration_done(i, iterations, thread_idx, tokens);
+    }
+}
+
+void ssp_train_lda(const std::vector<std::size_t> & thread_idx,
+                   std::vector< sparse_count_matrix_t > const& dwcm,
+                   std::vector< count_matrix_t > & tdcm,
+                   std::vector< count_matrix_t > & twcm,
+                   std::vector< token_topics > & tokens,
+                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+                   const std::size_t staleness,
+                   const sampler_type sampler,
+                   const sweep_order order,
+                   const std::uint64_t seed) {
+
+    const std::size_t n_threads = thread_idx.size();
+
+    std::vector< counter_rng > rngs;
+    shard_rngs(thread_idx, tokens, seed, rngs);
+
+    for_each_shard(thread_idx, [&dwcm, &tdcm, &twcm, &tokens, &rngs, n_topics](const std::size_t i) {
+        random_init(dwcm[i], tdcm[i], twcm[i], tokens[i], rngs[i], n_topics);
+    });
 
-        //twcm_base = hpx::reduce(hpx::execution::par, std::begin(twcm), std::end(twcm), twcm_base, adder);
-        twcm_base = hpx::reduce(std::begin(twcm), std::end(twcm), twcm_base, adder);
-        std::fill(std::begin(twcm), std::end(twcm), twcm_base);
+    // the shared model; shards add their changes with relaxed atomic adds
+    // and read it with relaxed atomic loads (counts.hpp)
+    //
+    count_matrix_t twcm_base(twcm[0].rows(), twcm[0].columns());
+    column_block_reduce(thread_idx, twcm, twcm_base, 4 * n_threads);
+    count_vector_t ztot_base = topic_totals(twcm_base);
+
+    const std::size_t n_words = twcm_base.columns();
+
+    // versions[w] counts the pushes into column w of the shared model;
+    // pulled[i][w] is the version shard i last copied, so a refresh only
+    // copies the columns pushed since. ztot_seen[i] is the shared topic
+    // totals as shard i last read them
+    //
+    std::vector< std::atomic<std::uint64_t> > versions(n_words);
+    for(std::size_t w = 0; w < n_words; ++w) {
+        versions[w].store(1);
     }
+
+    // a shard's changes are worked out from its token topics before the
+    // sweep (before[i]) rather than from a second copy of the model: one
+    // column of delta[i] per word the sweep changed, at slot[i][w]
+    //
+    std::vector< std::vector<std::uint64_t> > pulled(n_threads);
+    std::vector< std::vector<std::size_t> > refreshed(n_threads), slot(n_threads);
+    std::vector< std::vector<count_t> > delta(n_threads);
+    std::vector< token_topics > before(n_threads);
+    std::vector< count_vector_t > ztot(n_threads), ztot_seen(n_threads);
+    std::vector< DynamicVector<double> > probs(n_threads);
+    std::vector< sparse_buckets > buckets(n_threads);
+    std::vector< alias_tables > tables(n_threads);
+    std::vector< word_order > orders(n_threads);
+    std::vector< dirty_words > dirty(n_threads);
+
+    for_each_shard(thread_idx, [&dwcm, &pulled, &slot, &ztot, &ztot_seen, &probs, &orders, &dirty, n_topics, n_words, order](const std::size_t ti) {
+        pulled[ti].assign(n_words, 0);
+        slot[ti].resize(n_words);
+        ztot[ti].resize(n_topics);
+        ztot_seen[ti].resize(n_topics);
+        probs[ti].resize(n_topics);
+        probs[ti] = 0.0;
+        dirty[ti].resize(n_words);
+
+        if(order == sweep_order::word) {
+            build_word_order(dwcm[ti], n_words, orders[ti]);
+        }
+    });
+
+    double N = 0.0;
+    {
+        std::size_t Nsz = 0;
+        for(const auto& t : tokens) {
+            Nsz += t.size();
+        }
+
+        N = static_cast<double>(Nsz);
+    }
+
+    // clocks[i] is the number of iterations shard i has finished and
+    // added to the shared model
+    //
+    std::vector< std::atomic<std::size_t> > clocks(n_threads);
+    for(const std::size_t ti : thread_idx) {
+        clocks[ti].store(0);
+    }
+
+    for_each_shard(thread_idx, [&](const std::size_t ti) {
+        for(std::size_t i = 0; i < iterations; ++i) {
+
+            // wait for the slowest shard to come within staleness
+            // iterations; the acquire pairs with its release below, so
+            // its additions to the shared model are visible
+            //
+            if(i > staleness) {
+                const std::size_t oldest = i - staleness;
+                for(const std::size_t tj : thread_idx) {
+                    while(clocks[tj].load(std::memory_order_acquire) < oldest) {
+                        hpx::this_thread::yield();
+                    }
+                }
+            }
+
+            // refresh the replica's columns pushed since the shard last
+            // pulled them. a push racing the copy bumps the version after
+            // its adds, so a torn column is pulled again next sweep
+            //
+            refreshed[ti].clear();
+            for(std::size_t w = 0; w < n_words; ++w) {
+                const std::uint64_t v = versions[w].load(std::memory_order_acquire);
+                if(v == pulled[ti][w]) {
+                    continue;
+                }
+
+                const count_t * base_w = twcm_base.data(w);
+                count_t * twcm_w = twcm[ti].data(w);
+                for(std::size_t t = 0; t < n_topics; ++t) {
+                    twcm_w[t] = load_count(base_w[t]);
+                }
+                pulled[ti][w] = v;
+                refreshed[ti].push_back(w);
+            }
+
+            for(std::size_t t = 0; t < n_topics; ++t) {
+                ztot[ti][t] = load_count(ztot_base[t]);
+            }
+            ztot_seen[ti] = ztot[ti];
+
+            refresh_word_topics(buckets[ti], twcm[ti], refreshed[ti]);
+            before[ti] = tokens[ti];
+
+            rngs[ti].sweep(static_cast<std::uint32_t>(i));
+
+            switch(sampler) {
+                case sampler_type::sparse:
+                    sparse_gibbs(dwcm[ti], tdcm[ti], twcm[ti], tokens[ti], ztot[ti], buckets[ti], rngs[ti], n_topics, N, alpha, beta, &dirty[ti]);
+                    break;
+                case sampler_type::alias:
+                    alias_gibbs(dwcm[ti], tdcm[ti], twcm[ti], tokens[ti], ztot[ti], tables[ti], rngs[ti], n_topics, N, alpha, beta, model_sharing::replicated, &dirty[ti]);
+                    break;
+                default:
+                    if(order == sweep_order::word) {
+                        gibbs_words(orders[ti], tdcm[ti], twcm[ti], tokens[ti], ztot[ti], probs[ti], rngs[ti], n_topics, N, alpha, beta, model_sharing::replicated, &dirty[ti]);
+                    }
+                    else {
+                        gibbs(dwcm[ti], tdcm[ti], twcm[ti], tokens[ti], ztot[ti], probs[ti], rngs[ti], n_topics, N, alpha, beta, model_sharing::replicated, &dirty[ti]);
+                    }
+            }
+
+            // this sweep's changes are the tokens that moved topic
+            //
+            std::vector<std::size_t> const& changed = dirty[ti].words;
+            for(std::size_t j = 0; j < changed.size(); ++j) {
+                slot[ti][changed[j]] = j;
+            }
+            delta[ti].assign(changed.size() * n_topics, 0);
+
+            const std::size_t n_docs = dwcm[ti].rows();
+            std::size_t pos = 0;
+            for(std::size_t d = 0; d < n_docs; ++d) {
+                const auto dwcm_end = dwcm[ti].end(d);
+                for(sparse_count_matrix_t::ConstIterator it = dwcm[ti].begin(d); it != dwcm_end; ++it) {
+                    const std::size_t k_max = static_cast<std::size_t>(it->value());
+                    for(std::size_t k = 0; k < k_max; ++k, ++pos) {
+                        const std::size_t t = before[ti].get(pos);
+                        const std::size_t nt = tokens[ti].get(pos);
+                        if(t != nt) {
+                            count_t * delta_w = delta[ti].data() + slot[ti][it->index()] * n_topics;
+                            delta_w[t] -= 1;
+                            delta_w[nt] += 1;
+                        }
+                    }
+                }
+            }
+
+            // add them into the shared model, then bump the versions of
+            // the columns they went into
+            //
+            for(std::size_t j = 0; j < changed.size(); ++j) {
+                const std::size_t w = changed[j];
+                count_t * base_w = twcm_base.data(w);
+                const count_t * delta_w = delta[ti].data() + j * n_topics;
+                for(std::size_t t = 0; t < n_topics; ++t) {
+                    if(delta_w[t] != 0) {
+                        add_count<true>(base_w[t], delta_w[t]);
+                    }
+                }
+                versions[w].fetch_add(1, std::memory_order_release);
+            }
+
+            for(std::size_t t = 0; t < n_topics; ++t) {
+                const total_t d = ztot[ti][t] - ztot_seen[ti][t];
+                if(d != 0) {
+                    add_count<true>(ztot_base[t], d);
+                }
+            }
+
+            dirty[ti].clear();
+            clocks[ti].store(i + 1, std::memory_order_release);
+        }
+    });
+
+    // every shard's changes are in twcm_base
+    //
+    column_block_broadcast(thread_idx, twcm_base, twcm, 4 * n_threads);
 }
 
 #endif
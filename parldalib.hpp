@@ -13,14 +13,73 @@
 #include <unicode/unistr.h>
 #include <blaze/Math.h>
 
+#include "gibbs.hpp"
+#include "counts.hpp"
+#include "checkpoint.hpp"
+
 using blaze::DynamicMatrix;
 using blaze::DynamicVector;
 using blaze::CompressedMatrix;
 
+// trains the shards of thread_idx in parallel; shard i owns dwcm[i],
+// tdcm[i] and tokens[i]. with model_sharing::replicated every shard has
+// its own twcm[i] and all of them hold the merged model on return. with
+// model_sharing::shared only twcm[0] is used (and needs to be sized),
+// and sampler_type::sparse is not supported
+//
+// with rebalance above zero, documents move between shards after any
+// sweep where the slowest shard took more than (1 + rebalance) times the
+// mean time (see rebalance.hpp); shards remain contiguous runs of the
+// documents, use shard_bounds for their ranges on return
+//
+// checkpoint sets where the shards' topics are saved and the iteration
+// training starts at (checkpoint.hpp); rotation_train_lda takes it too
+//
 void par_train_lda(const std::vector<std::size_t> & thread_idx,
-                   std::vector< CompressedMatrix<double> > const& dwcm,
-                   std::vector< DynamicMatrix<double> > & tdcm,
-                   std::vector< DynamicMatrix<double> > & twcm,
-                   std::vector< std::vector<std::size_t> > & tokens,
-                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta);
+                   std::vector< sparse_count_matrix_t > & dwcm,
+                   std::vector< count_matrix_t > & tdcm,
+                   std::vector< count_matrix_t > & twcm,
+                   std::vector< token_topics > & tokens,
+                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+                   const sampler_type sampler = sampler_type::dense,
+                   const sweep_order order = sweep_order::document,
+                   const std::uint64_t seed = 0,
+                   const model_sharing sharing = model_sharing::replicated,
+                   const double rebalance = 0.0,
+                   checkpoint_config const& checkpoint = checkpoint_config{});
+
+// model-parallel trainer (NOMAD style diagonal scheduling); the vocabulary
+// is split into one block per shard and each iteration runs one round per
+// block. in round r shard i samples its tokens of block (i + r) mod n with
+// the dense sampler in word order, so every block of the single twcm is
+// updated by one thread at a time: no replicas and no reduction
+//
+void rotation_train_lda(const std::vector<std::size_t> & thread_idx,
+                   std::vector< sparse_count_matrix_t > const& dwcm,
+                   std::vector< count_matrix_t > & tdcm,
+                   count_matrix_t & twcm,
+                   std::vector< token_topics > & tokens,
+                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+                   const std::uint64_t seed = 0,
+                   checkpoint_config const& checkpoint = checkpoint_config{});
+// stale synchronous parallel trainer (SSP); shards don't wait for each
+// other at the end of an iteration. shard i runs its own iterations
+// against its replica twcm[i]; before each sweep it copies the columns
+// of the shared model that changed since it last read them, and
+// afterwards adds the moves of its tokens back into the shared model. a shard starts iteration j once every shard has finished
+// iteration j - staleness, so a replica misses at most staleness
+// iterations of the other shards' updates; it may also pick up some
+// updates of shards that are further along, so runs are not
+// reproducible. all replicas hold the final model on return
+//
+void ssp_train_lda(const std::vector<std::size_t> & thread_idx,
+                   std::vector< sparse_count_matrix_t > const& dwcm,
+                   std::vector< count_matrix_t > & tdcm,
+                   std::vector< count_matrix_t > & twcm,
+                   std::vector< token_topics > & tokens,
+                   const std::size_t n_topics, const std::size_t iterations, const double alpha, const double beta,
+                   const std::size_t staleness,
+                   const sampler_type sampler = sampler_type::dense,
+                   const sweep_order order = sweep_order::document,
+                   const std::uint64_t seed = 0);
 #endif
@@ -41,10 +41,10 @@ void lda(std::string path, std::vector<std::string> vocab, std::string regex, co
         vocabulary.insert({vocab[i], i});
     }
 
-    CompressedMatrix<double> dwcm;
-    DynamicMatrix<double> tdcm, twcm;
+    sparse_count_matrix_t dwcm;
+    count_matrix_t tdcm, twcm;
 
-    std::vector<std::size_t> tokens;
+    token_topics tokens;
 
     std::vector< fs::path > paths;
     {
@@ -57,14 +57,14 @@ void lda(std::string path, std::vector<std::string> vocab, std::string regex, co
 
         tdcm.resize( n_topics, ndocs );
         twcm.resize( n_topics, vocab_sz );
-        tdcm = 0.0;
-        twcm = 0.0;
+        tdcm = 0;
+        twcm = 0;
 
         document_path_to_inverted_index(beg, end, regexp, ii, vocabulary);
-        CompressedMatrix<double> wdcm;
+        sparse_count_matrix_t wdcm;
         inverted_index_to_matrix(vocabulary, ii, ndocs, wdcm);
         dwcm = blaze::trans(wdcm);
-        matrix_to_vector(dwcm, tokens);
+        matrix_to_vector(dwcm, tokens, n_topics);
     }
 
     train_lda(dwcm, tdcm, twcm, tokens, n_topics, iterations, alpha, beta);
@@ -80,10 +80,10 @@ void lda(std::string path, std::string vocab_path, std::string regex, const std:
 
     const std::size_t vocab_sz = load_wordlist(wpth, vocabulary);
 
-    CompressedMatrix<double> dwcm;
-    DynamicMatrix<double> tdcm, twcm;
+    sparse_count_matrix_t dwcm;
+    count_matrix_t tdcm, twcm;
 
-    std::vector<std::size_t> tokens;
+    token_topics tokens;
 
     std::vector< fs::path > paths;
     {
@@ -96,14 +96,14 @@ void lda(std::string path, std::string vocab_path, std::string regex, const std:
 
         tdcm.resize( n_topics, ndocs );
         twcm.resize( n_topics, vocab_sz );
-        tdcm = 0.0;
-        twcm = 0.0;
+        tdcm = 0;
+        twcm = 0;
 
         document_path_to_inverted_index(beg, end, regexp, ii, vocabulary);
-        CompressedMatrix<double> wdcm;
+        sparse_count_matrix_t wdcm;
         inverted_index_to_matrix(vocabulary, ii, ndocs, wdcm);
         dwcm = blaze::trans(wdcm);
-        matrix_to_vector(dwcm, tokens);
+        matrix_to_vector(dwcm, tokens, n_topics);
     }
 
     train_lda(dwcm, tdcm, twcm, tokens, n_topics, iterations, alpha, beta);
@@ -0,0 +1,230 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+
+#include <blaze/Math.h>
+
+#include "rebalance.hpp"
+#include "gibbs.hpp"
+#include "documents.hpp"
+
+double barrier_wait(std::vector<std::size_t> const& thread_idx, std::vector<double> const& seconds) {
+    double slowest = 0.0;
+    for(const std::size_t ti : thread_idx) {
+        slowest = std::max(slowest, seconds[ti]);
+    }
+
+    double wait = 0.0;
+    for(const std::size_t ti : thread_idx) {
+        wait += slowest - seconds[ti];
+    }
+    return wait;
+}
+
+void shard_bounds(std::vector<std::size_t> const& thread_idx, std::vector< sparse_count_matrix_t > const& dwcm, std::vector<std::size_t> & bounds) {
+    bounds.assign(thread_idx.size()+1, 0);
+    for(const std::size_t ti : thread_idx) {
+        bounds[ti+1] = bounds[ti] + dwcm[ti].rows();
+    }
+}
+
+bool rebalance_bounds(std::vector<std::size_t> const& thread_idx,
+                      std::vector< sparse_count_matrix_t > const& dwcm,
+                      std::vector< token_topics > const& tokens,
+                      std::vector<double> const& seconds,
+                      const double tolerance,
+                      std::vector<std::size_t> & bounds) {
+
+    const std::size_t n_threads = thread_idx.size();
+    if(n_threads < 2) {
+        return false;
+    }
+
+    double total_seconds = 0.0, slowest = 0.0;
+    std::size_t total_tokens = 0;
+    for(const std::size_t ti : thread_idx) {
+        total_seconds += seconds[ti];
+        slowest = std::max(slowest, seconds[ti]);
+        total_tokens += tokens[ti].size();
+    }
+
+    const double mean = total_seconds / static_cast<double>(n_threads);
+    if(total_tokens == 0 || mean <= 0.0 || slowest <= (1.0 + tolerance) * mean) {
+        return false;
+    }
+
+    // tokens/sec of each shard; a shard without tokens (or time) is
+    // assumed to run at the overall rate
+    //
+    const double overall = static_cast<double>(total_tokens) / total_seconds;
+    std::vector<double> shares(n_threads);
+    double total_rate = 0.0;
+    for(const std::size_t ti : thread_idx) {
+        shares[ti] = (tokens[ti].size() > 0 && seconds[ti] > 0.0) ?
+            static_cast<double>(tokens[ti].size()) / seconds[ti] : overall;
+        total_rate += shares[ti];
+    }
+
+    for(const std::size_t ti : thread_idx) {
+        shares[ti] /= total_rate;
+    }
+
+    std::vector<std::size_t> doc_lens;
+    for(const std::size_t ti : thread_idx) {
+        const std::size_t n_docs = dwcm[ti].rows();
+        for(std::size_t d = 0; d < n_docs; ++d) {
+            doc_lens.push_back(doc_tokens(dwcm[ti], d));
+        }
+    }
+
+    std::vector<std::size_t> current;
+    shard_bounds(thread_idx, dwcm, current);
+    balanced_partition(doc_lens, shares, bounds);
+
+    // documents aren't split, so a long document can leave the
+    // partition where it was
+    //
+    return bounds != current;
+}
+
+std::vector<std::size_t> migrate_documents(std::vector<std::size_t> const& thread_idx,
+                      std::vector<std::size_t> const& bounds,
+                      std::vector< sparse_count_matrix_t > & dwcm,
+                      std::vector< count_matrix_t > & tdcm,
+                      std::vector< token_topics > & tokens,
+                      shard_runner const& run_shards) {
+
+    const std::size_t n_threads = thread_idx.size();
+
+    std::vector<std::size_t> old_bounds;
+    shard_bounds(thread_idx, dwcm, old_bounds);
+
+    std::vector<std::size_t> moved;
+    for(const std::size_t ti : thread_idx) {
+        if(bounds[ti] != old_bounds[ti] || bounds[ti+1] != old_bounds[ti+1]) {
+            moved.push_back(ti);
+        }
+    }
+
+    // position of each document's first token in its current shard
+    //
+    std::vector< std::vector<std::size_t> > doc_first(n_threads);
+    for(const std::size_t ti : thread_idx) {
+        const std::size_t n_docs = dwcm[ti].rows();
+        doc_first[ti].assign(n_docs+1, 0);
+        for(std::size_t d = 0; d < n_docs; ++d) {
+            doc_first[ti][d+1] = doc_first[ti][d] + doc_tokens(dwcm[ti], d);
+        }
+    }
+
+    // shard currently holding document doc; empty shards share their
+    // bound with the next shard and are skipped by upper_bound
+    //
+    const auto owner = [&old_bounds](const std::size_t doc) {
+        return static_cast<std::size_t>(std::upper_bound(std::begin(old_bounds), std::end(old_bounds), doc) - std::begin(old_bounds)) - 1;
+    };
+
+    std::vector< sparse_count_matrix_t > new_dwcm(n_threads);
+    std::vector< count_matrix_t > new_tdcm(n_threads);
+    std::vector< token_topics > new_tokens(n_threads);
+
+    // each moved shard only reads the old shards and writes its own new
+    // state, so the shards copy concurrently, each on its own worker
+    //
+    run_shards(moved, [&](const std::size_t ti) {
+        const std::size_t first = bounds[ti];
+        const std::size_t n_docs = bounds[ti+1] - first;
+        const std::size_t n_topics = tdcm[ti].rows();
+
+        std::size_t nnz = 0, n_tokens = 0;
+        for(std::size_t d = 0; d < n_docs; ++d) {
+            const std::size_t j = owner(first + d);
+            const std::size_t ld = first + d - old_bounds[j];
+            nnz += dwcm[j].nonZeros(ld);
+            n_tokens += doc_first[j][ld+1] - doc_first[j][ld];
+        }
+
+        new_dwcm[ti].resize(n_docs, dwcm[ti].columns(), false);
+        new_dwcm[ti].reserve(nnz);
+        new_tdcm[ti].resize(n_topics, n_docs);
+        new_tokens[ti].resize(n_tokens, n_topics);
+
+        std::size_t pos = 0;
+        for(std::size_t d = 0; d < n_docs; ++d) {
+            const std::size_t j = owner(first + d);
+            const std::size_t ld = first + d - old_bounds[j];
+
+            const auto dwcm_end = dwcm[j].end(ld);
+            for(sparse_count_matrix_t::ConstIterator it = dwcm[j].begin(ld); it != dwcm_end; ++it) {
+                new_dwcm[ti].append(d, it->index(), it->value());
+            }
+            new_dwcm[ti].finalize(d);
+
+            std::copy_n(tdcm[j].data(ld), n_topics, new_tdcm[ti].data(d));
+
+            for(std::size_t k = doc_first[j][ld]; k < doc_first[j][ld+1]; ++k) {
+                new_tokens[ti].set(pos++, tokens[j].get(k));
+            }
+        }
+    });
+
+    for(const std::size_t ti : moved) {
+        std::swap(dwcm[ti], new_dwcm[ti]);
+        std::swap(tdcm[ti], new_tdcm[ti]);
+        std::swap(tokens[ti], new_tokens[ti]);
+    }
+
+    return moved;
+}
+
+std::vector<std::size_t> rebalance_shards(std::string const& prefix,
+                      const std::size_t iteration, const std::size_t iterations,
+                      std::vector<std::size_t> const& thread_idx,
+                      std::vector<double> const& seconds,
+                      const double tolerance,
+                      std::vector< sparse_count_matrix_t > & dwcm,
+                      std::vector< count_matrix_t > & tdcm,
+                      std::vector< token_topics > & tokens,
+                      shard_runner const& run_shards,
+                      bool & pending) {
+
+    if(pending) {
+        std::cerr << prefix << ": iteration " << iteration << " barrier wait after rebalance " << barrier_wait(thread_idx, seconds) << " s" << std::endl;
+        pending = false;
+    }
+
+    std::vector<std::size_t> bounds;
+    if((iteration + 1) >= iterations || !rebalance_bounds(thread_idx, dwcm, tokens, seconds, tolerance, bounds)) {
+        return std::vector<std::size_t>{};
+    }
+
+    std::vector<std::size_t> old_bounds;
+    shard_bounds(thread_idx, dwcm, old_bounds);
+
+    std::cerr << prefix << ": iteration " << iteration << " barrier wait before rebalance " << barrier_wait(thread_idx, seconds) << " s" << std::endl;
+
+    const std::size_t n_threads = thread_idx.size();
+    std::vector<std::size_t> n_tokens(n_threads);
+    for(const std::size_t ti : thread_idx) {
+        n_tokens[ti] = tokens[ti].size();
+    }
+
+    std::vector<std::size_t> moved = migrate_documents(thread_idx, bounds, dwcm, tdcm, tokens, run_shards);
+
+    for(const std::size_t ti : moved) {
+        std::cerr << prefix << ": iteration " << iteration << " shard " << ti
+                  << " (" << seconds[ti] << " s) documents [" << old_bounds[ti] << ", " << old_bounds[ti+1] << ") -> ["
+                  << bounds[ti] << ", " << bounds[ti+1] << "), tokens " << n_tokens[ti] << " -> " << tokens[ti].size() << std::endl;
+    }
+
+    pending = !moved.empty();
+    return moved;
+}
@@ -0,0 +1,86 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __MINIATURIST_REBALANCE_HPP__
+#define __MINIATURIST_REBALANCE_HPP__
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+#include "counts.hpp"
+#include "token_topics.hpp"
+
+// moves documents between a trainer's shards between iterations, using
+// the time each shard spent sampling in the last sweep
+//
+// shards hold contiguous runs of documents (shard i has documents
+// [bounds[i], bounds[i+1]) of the shards' concatenation), so moving a
+// boundary keeps every token at the same global position; the counter_rng
+// streams and the output order of the documents are unchanged
+//
+
+// runs f(i) for every shard i of the given shards and waits for all of
+// them. the HPX trainers pass for_each_shard (shard_placement.hpp), so a
+// shard's new state is allocated and first touched by the shard's own
+// worker; this file is also built into lda, which has no HPX runtime
+//
+using shard_runner = std::function<void(std::vector<std::size_t> const&, std::function<void(const std::size_t)> const&)>;
+
+// seconds the shards wait on the slowest one, summed over shards
+//
+double barrier_wait(std::vector<std::size_t> const& thread_idx, std::vector<double> const& seconds);
+
+// first document of every shard, and one past the last document of the
+// last shard
+//
+void shard_bounds(std::vector<std::size_t> const& thread_idx, std::vector< sparse_count_matrix_t > const& dwcm, std::vector<std::size_t> & bounds);
+
+// when the slowest shard took more than (1 + tolerance) times the mean
+// sampling time, sets bounds to give every shard tokens in proportion to
+// its measured tokens/sec and returns true
+//
+bool rebalance_bounds(std::vector<std::size_t> const& thread_idx,
+                      std::vector< sparse_count_matrix_t > const& dwcm,
+                      std::vector< token_topics > const& tokens,
+                      std::vector<double> const& seconds,
+                      const double tolerance,
+                      std::vector<std::size_t> & bounds);
+
+// moves documents (dwcm rows, tdcm columns and token topics) so shard i
+// holds documents [bounds[i], bounds[i+1]); the changed shards build
+// their new state concurrently through run_shards. returns the shards
+// whose documents changed
+//
+std::vector<std::size_t> migrate_documents(std::vector<std::size_t> const& thread_idx,
+                      std::vector<std::size_t> const& bounds,
+                      std::vector< sparse_count_matrix_t > & dwcm,
+                      std::vector< count_matrix_t > & tdcm,
+                      std::vector< token_topics > & tokens,
+                      shard_runner const& run_shards);
+
+// called after the sweep of every iteration when rebalancing is enabled.
+// logs the barrier wait of the sweep that followed the last move (when
+// pending is set), then, unless this was the last iteration, moves
+// documents when rebalance_bounds calls for it, logging the moved
+// documents and the barrier wait before the move to std::cerr. returns
+// the shards whose documents changed; their counter_rng offsets and
+// word orders need to be rebuilt
+//
+std::vector<std::size_t> rebalance_shards(std::string const& prefix,
+                      const std::size_t iteration, const std::size_t iterations,
+                      std::vector<std::size_t> const& thread_idx,
+                      std::vector<double> const& seconds,
+                      const double tolerance,
+                      std::vector< sparse_count_matrix_t > & dwcm,
+                      std::vector< count_matrix_t > & tdcm,
+                      std::vector< token_topics > & tokens,
+                      shard_runner const& run_shards,
+                      bool & pending);
+
+#endif
@@ -30,7 +30,7 @@ inline void argsort(Vector const& v, std::vector<std::size_t> & args) {
     });
 }
 
-void print_topics(std::unordered_map<std::string, std::size_t> const& vocabulary, DynamicMatrix<double> const& twcm, const std::size_t n_topics, const std::size_t mxtokens) {
+void print_topics(std::unordered_map<std::string, std::size_t> const& vocabulary, count_matrix_t const& twcm, const std::size_t n_topics, const std::size_t mxtokens) {
     const std::size_t ntopics = twcm.rows();
     assert(ntopics == n_topics);
 
@@ -41,7 +41,7 @@ void print_topics(std::unordered_map<std::string, std::size_t> const& vocabulary
     std::wcin.imbue(std::locale());
     std::wcout.imbue(std::locale());
 
-    DynamicVector<double> ztot = blaze::sum<blaze::rowwise>(twcm);
+    DynamicVector<double> ztot(topic_totals(twcm));
     ztot /= blaze::sum(ztot);
 
     std::vector<std::size_t> idx(vocabulary.size());
@@ -52,6 +52,9 @@ void print_topics(std::unordered_map<std::string, std::size_t> const& vocabulary
         voc_idx[v.second] = v.first;
     }
 
+    // twcm is column-major (see counts.hpp); gathering a topic's row is
+    // strided but only happens once per topic when results are printed
+    //
     for(std::size_t t = 0; t < n_topics; ++t) {
         DynamicVector<double, blaze::rowVector> tw = blaze::row(twcm, t);
         tw = -tw;
@@ -71,7 +74,45 @@ void print_topics(std::unordered_map<std::string, std::size_t> const& vocabulary
     std::cout << "prob sum\t" << blaze::sum(ztot) << std::endl;
 }
 
-void print_document_topics(DynamicMatrix<double> const& tdcm, const std::size_t n_topics, const std::size_t docbeg, const std::size_t docend, const std::size_t mxtopics) {
+void print_topics(std::unordered_map<std::string, std::size_t> const& vocabulary, std::vector< std::vector<std::size_t> > const& top, count_vector_t const& ztot, const std::size_t n_topics) {
+    assert(top.size() == n_topics);
+
+    constexpr char locale_name[] = "";
+    setlocale( LC_ALL, locale_name );
+    std::locale::global(std::locale(locale_name));
+    std::ios_base::sync_with_stdio(false);
+    std::wcin.imbue(std::locale());
+    std::wcout.imbue(std::locale());
+
+    DynamicVector<double> zprob(ztot.size());
+    for(std::size_t t = 0; t < ztot.size(); ++t) {
+        zprob[t] = static_cast<double>(ztot[t]);
+    }
+    zprob /= blaze::sum(zprob);
+
+    std::vector<std::string> voc_idx(vocabulary.size());
+    for(const auto& v : vocabulary) {
+        voc_idx[v.second] = v.first;
+    }
+
+    for(std::size_t t = 0; t < n_topics; ++t) {
+        std::cout << "topic " << t << '\t' << zprob[t] << '\t';
+
+        const std::size_t mxtokens = top[t].size();
+        for(std::size_t m = 0; m < mxtokens; ++m) {
+           if(m == (mxtokens-1)) {
+               std::cout << voc_idx[top[t][m]];
+           }
+           else {
+               std::cout << voc_idx[top[t][m]] << ' ';
+           }
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "prob sum\t" << blaze::sum(zprob) << std::endl;
+}
+
+void print_document_topics(count_matrix_t const& tdcm, const std::size_t n_topics, const std::size_t docbeg, const std::size_t docend, const std::size_t mxtopics) {
     const std::size_t ntopics = tdcm.rows();
     assert(ntopics == n_topics);
 
@@ -105,7 +146,7 @@ void print_document_topics(DynamicMatrix<double> const& tdcm, const std::size_t
     }
 }
 
-void json_topic_matrices(std::string const& prefix, CompressedMatrix<double> const& dwcm, DynamicMatrix<double> const& tdcm, DynamicMatrix<double> const& twcm) {
+void json_topic_matrices(std::string const& prefix, sparse_count_matrix_t const& dwcm, count_matrix_t const& tdcm, count_matrix_t const& twcm) {
     std::ofstream fs(prefix + ".json");
     fs << "[ { 'name' : 'dwcm', " << std::endl
        << " 'data_size' : 1, " << std::endl
@@ -121,12 +162,12 @@ void json_topic_matrices(std::string const& prefix, CompressedMatrix<double> con
     fs.close();
 }
 
-void json_topic_matrices(const std::size_t locality, std::string const& prefix, CompressedMatrix<double> const& dwcm, DynamicMatrix<double> const& tdcm, DynamicMatrix<double> const& twcm) {
+void json_topic_matrices(const std::size_t locality, std::string const& prefix, sparse_count_matrix_t const& dwcm, count_matrix_t const& tdcm, count_matrix_t const& twcm) {
     std::string tprefix{ prefix + "_" + std::to_string(locality) };
     json_topic_matrices(tprefix, dwcm, tdcm, twcm);
 }
 
-void json_topic_matrices(std::string const& prefix, std::vector<CompressedMatrix<double>> const& dwcm, std::vector<DynamicMatrix<double>> const& tdcm, std::vector<DynamicMatrix<double>> const& twcm) {
+void json_topic_matrices(std::string const& prefix, std::vector<sparse_count_matrix_t> const& dwcm, std::vector<count_matrix_t> const& tdcm, std::vector<count_matrix_t> const& twcm) {
     std::ofstream fs(prefix + ".json");
     fs << "[ { 'name' : 'dwcm', " << std::endl
        << " 'data_size' : " << dwcm.size() << ", " << std::endl
@@ -166,7 +207,7 @@ void json_topic_matrices(std::string const& prefix, std::vector<CompressedMatrix
     fs.close();
 }
 
-void json_topic_matrices(const std::size_t locality, std::string const& prefix, std::vector<CompressedMatrix<double>> const& dwcm, std::vector<DynamicMatrix<double>> const& tdcm, std::vector<DynamicMatrix<double>> const& twcm) {
+void json_topic_matrices(const std::size_t locality, std::string const& prefix, std::vector<sparse_count_matrix_t> const& dwcm, std::vector<count_matrix_t> const& tdcm, std::vector<count_matrix_t> const& twcm) {
     std::string tprefix{ prefix + "_" + std::to_string(locality) };
     json_topic_matrices(tprefix, dwcm, tdcm, twcm);
 }
@@ -16,6 +16,8 @@
 #include <unicode/unistr.h>
 #include <blaze/Math.h>
 
+#include "counts.hpp"
+
 #ifdef ICU69
 using icu_69::UnicodeString;
 #else
@@ -27,17 +29,22 @@ using blaze::CompressedMatrix;
 
 using namespace blaze;
 
-void print_topics(std::unordered_map<std::string, std::size_t> const& vocabulary, DynamicMatrix<double> const& tdcm, const std::size_t n_topics, const std::size_t mxtokens=8);
+void print_topics(std::unordered_map<std::string, std::size_t> const& vocabulary, count_matrix_t const& twcm, const std::size_t n_topics, const std::size_t mxtokens=8);
+
+// print_topics for a model nobody holds whole (param_server.hpp); top[t]
+// are the words of topic t, most frequent first, and ztot the topic totals
+//
+void print_topics(std::unordered_map<std::string, std::size_t> const& vocabulary, std::vector< std::vector<std::size_t> > const& top, count_vector_t const& ztot, const std::size_t n_topics);
 
-void print_document_topics(DynamicMatrix<double> const& tdcm, const std::size_t n_topics, const std::size_t docbeg, const std::size_t docend, const std::size_t mxtopics=-1);
+void print_document_topics(count_matrix_t const& tdcm, const std::size_t n_topics, const std::size_t docbeg, const std::size_t docend, const std::size_t mxtopics=-1);
 
-void json_topic_matrices(std::string const& prefix, CompressedMatrix<double> const& dwcm, DynamicMatrix<double> const& tdcm, DynamicMatrix<double> const& twcm);
+void json_topic_matrices(std::string const& prefix, sparse_count_matrix_t const& dwcm, count_matrix_t const& tdcm, count_matrix_t const& twcm);
 
-void json_topic_matrices(const std::size_t locality, std::string const& prefix, CompressedMatrix<double> const& dwcm, DynamicMatrix<double> const& tdcm, DynamicMatrix<double> const& twcm);
+void json_topic_matrices(const std::size_t locality, std::string const& prefix, sparse_count_matrix_t const& dwcm, count_matrix_t const& tdcm, count_matrix_t const& twcm);
 
-void json_topic_matrices(std::string const& prefix, std::vector<CompressedMatrix<double>> const& dwcm, std::vector<DynamicMatrix<double>> const& tdcm, std::vector<DynamicMatrix<double>> const& twcm);
+void json_topic_matrices(std::string const& prefix, std::vector<sparse_count_matrix_t> const& dwcm, std::vector<count_matrix_t> const& tdcm, std::vector<count_matrix_t> const& twcm);
 
-void json_topic_matrices(const std::size_t locality, std::string const& prefix, std::vector<CompressedMatrix<double>> const& dwcm, std::vector<DynamicMatrix<double>> const& tdcm, std::vector<DynamicMatrix<double>> const& twcm);
+void json_topic_matrices(const std::size_t locality, std::string const& prefix, std::vector<sparse_count_matrix_t> const& dwcm, std::vector<count_matrix_t> const& tdcm, std::vector<count_matrix_t> const& twcm);
 
 
 #endif
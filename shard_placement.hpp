@@ -0,0 +1,151 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __MINIATURIST_SHARD_PLACEMENT_HPP__
+#define __MINIATURIST_SHARD_PLACEMENT_HPP__
+
+#include <hpx/config.hpp>
+#include <hpx/future.hpp>
+#include <hpx/execution.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <cstdint>
+#include <cstdlib>
+
+#ifdef MINIATURIST_HWLOC
+#include <hwloc.h>
+#endif
+
+#include "counts.hpp"
+#include "token_topics.hpp"
+
+// shard i of a trainer is always run by HPX worker thread i (modulo the
+// number of workers) as a bound task, one the scheduler won't migrate
+// to another worker. memory a shard allocates and first touches inside
+// for_each_shard is placed on the NUMA domain of its worker (workers are
+// pinned to cores by default, see --hpx:bind), and later sweeps of the
+// shard run on that same worker instead of wherever hpx::for_each put
+// them
+//
+
+// runs f(i) for every shard i of thread_idx, each on its own worker,
+// and waits for all of them
+//
+template<typename F>
+void for_each_shard(std::vector<std::size_t> const& thread_idx, F && f) {
+    const std::size_t n_workers = hpx::get_num_worker_threads();
+
+    std::vector< hpx::future<void> > shards;
+    shards.reserve(thread_idx.size());
+
+    for(const std::size_t ti : thread_idx) {
+        hpx::execution::parallel_executor exec(
+            hpx::threads::thread_priority::bound,
+            hpx::threads::thread_stacksize::default_,
+            hpx::threads::thread_schedule_hint(static_cast<std::int16_t>(ti % n_workers)));
+
+        shards.push_back(hpx::async(exec, [&f, ti]() { f(ti); }));
+    }
+
+    // get() rethrows the first exception of a shard
+    //
+    for(auto & s : shards) {
+        s.get();
+    }
+}
+
+// for_each_shard as a shard_runner (rebalance.hpp)
+//
+inline void run_on_shards(std::vector<std::size_t> const& thread_idx, std::function<void(const std::size_t)> const& f) {
+    for_each_shard(thread_idx, f);
+}
+
+// the regions of memory a shard owns, by name, for report_placement
+//
+using shard_regions = std::vector< std::pair< std::string, std::pair<const void *, std::size_t> > >;
+
+// the count matrices and token topics of a shard
+//
+inline shard_regions shard_state_regions(sparse_count_matrix_t const& dwcm, count_matrix_t const& tdcm, count_matrix_t const& twcm, token_topics const& tokens) {
+    shard_regions regions;
+
+    // a CompressedMatrix keeps its non-zero elements in one array that
+    // starts at the first element of row 0
+    //
+    if(dwcm.rows() > 0 && dwcm.nonZeros() > 0) {
+        regions.emplace_back("dwcm", std::make_pair(static_cast<const void *>(&(*dwcm.begin(0))), dwcm.nonZeros() * sizeof(*dwcm.begin(0))));
+    }
+    else {
+        regions.emplace_back("dwcm", std::make_pair(static_cast<const void *>(nullptr), std::size_t{0}));
+    }
+
+    regions.emplace_back("tdcm", std::make_pair(static_cast<const void *>(tdcm.data()), tdcm.spacing() * tdcm.columns() * sizeof(count_t)));
+    regions.emplace_back("twcm", std::make_pair(static_cast<const void *>(twcm.data()), twcm.spacing() * twcm.columns() * sizeof(count_t)));
+    regions.emplace_back("tokens", std::make_pair(static_cast<const void *>(tokens.words.data()), tokens.bytes()));
+    return regions;
+}
+
+// prints, from inside for_each_shard, the worker and NUMA node running
+// shard ti and the NUMA nodes holding the pages of each of its regions
+// to std::cerr; without hwloc only the worker is reported
+//
+inline void report_placement(std::string const& prefix, const std::size_t ti, shard_regions const& regions) {
+    std::ostringstream line;
+    line << prefix << ": shard " << ti << " worker " << hpx::get_worker_thread_num();
+
+#ifdef MINIATURIST_HWLOC
+    hwloc_topology_t topology;
+    hwloc_topology_init(&topology);
+    hwloc_topology_load(topology);
+
+    hwloc_bitmap_t cpuset = hwloc_bitmap_alloc();
+    hwloc_bitmap_t nodeset = hwloc_bitmap_alloc();
+    char * str = nullptr;
+
+    if(hwloc_get_last_cpu_location(topology, cpuset, HWLOC_CPUBIND_THREAD) == 0) {
+        hwloc_cpuset_to_nodeset(topology, cpuset, nodeset);
+        hwloc_bitmap_list_asprintf(&str, cpuset);
+        line << " pu " << str;
+        free(str);
+        hwloc_bitmap_list_asprintf(&str, nodeset);
+        line << " numa " << str;
+        free(str);
+    }
+
+    for(const auto & r : regions) {
+        hwloc_bitmap_zero(nodeset);
+        line << ", " << r.first << " ";
+        if(r.second.second == 0) {
+            line << "empty";
+        }
+        else if(hwloc_get_area_memlocation(topology, r.second.first, r.second.second, nodeset, HWLOC_MEMBIND_BYNODESET) == 0) {
+            hwloc_bitmap_list_asprintf(&str, nodeset);
+            line << "numa " << str;
+            free(str);
+        }
+        else {
+            line << "unknown";
+        }
+    }
+
+    hwloc_bitmap_free(nodeset);
+    hwloc_bitmap_free(cpuset);
+    hwloc_topology_destroy(topology);
+#else
+    static_cast<void>(regions);
+    line << " (built without hwloc, no NUMA report)";
+#endif
+
+    std::cerr << line.str() << std::endl;
+}
+
+#endif
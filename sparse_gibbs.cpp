@@ -0,0 +1,270 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "sparse_gibbs.hpp"
+#include "gibbs.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <blaze/Math.h>
+
+using blaze::DynamicMatrix;
+using blaze::DynamicVector;
+using blaze::CompressedMatrix;
+
+// word topics are kept in increasing order, so the index is the same
+// however it got there and a sweep's draws only depend on the counts
+// (a resumed run retraces an uninterrupted one)
+//
+static inline void remove_word_topic(std::vector<std::size_t> & topics, const std::size_t t) {
+    std::vector<std::size_t>::iterator itr = std::lower_bound(topics.begin(), topics.end(), t);
+    if(itr == topics.end() || (*itr) != t) {
+        return;
+    }
+    topics.erase(itr);
+}
+
+static inline void insert_word_topic(std::vector<std::size_t> & topics, const std::size_t t) {
+    topics.insert(std::lower_bound(topics.begin(), topics.end(), t), t);
+}
+
+// topics present in column w
+//
+static inline void index_word(std::vector<std::size_t> & topics, count_matrix_t const& twcm, const std::size_t w) {
+    const std::size_t n_topics = twcm.rows();
+    const count_t * twcm_w = twcm.data(w);
+
+    topics.clear();
+    for(std::size_t t = 0; t < n_topics; ++t) {
+        if(twcm_w[t] > 0) {
+            topics.push_back(t);
+        }
+    }
+}
+
+static void build_word_topics(sparse_buckets & buckets, sparse_count_matrix_t const& dwcm, count_matrix_t const& twcm) {
+    const std::size_t n_docs = dwcm.rows();
+    const std::size_t n_words = twcm.columns();
+
+    for(const std::size_t w : buckets.index_words) {
+        buckets.word_topics[w].clear();
+        buckets.indexed[w] = 0;
+    }
+    buckets.index_words.clear();
+    buckets.word_topics.resize(n_words);
+    buckets.indexed.resize(n_words, 0);
+
+    for(std::size_t d = 0; d < n_docs; ++d) {
+        const auto dwcm_end = dwcm.end(d);
+        for(sparse_count_matrix_t::ConstIterator it = dwcm.begin(d); it != dwcm_end; ++it) {
+            const std::size_t w = it->index();
+            if(buckets.indexed[w] == 0) {
+                buckets.indexed[w] = 1;
+                buckets.index_words.push_back(w);
+                index_word(buckets.word_topics[w], twcm, w);
+            }
+        }
+    }
+
+    buckets.index_valid = true;
+}
+
+void reset_word_topics(sparse_buckets & buckets) {
+    buckets.index_valid = false;
+}
+
+void refresh_word_topics(sparse_buckets & buckets, count_matrix_t const& twcm, std::vector<std::size_t> const& words) {
+    if(!buckets.index_valid) {
+        return;
+    }
+
+    for(const std::size_t w : words) {
+        if(buckets.indexed[w] != 0) {
+            index_word(buckets.word_topics[w], twcm, w);
+        }
+    }
+}
+
+static inline void remove_doc_topic(sparse_buckets & buckets, const std::size_t t) {
+    const std::size_t pos = buckets.doc_pos[t];
+    const std::size_t last = buckets.doc_topics.back();
+    buckets.doc_topics[pos] = last;
+    buckets.doc_pos[last] = pos;
+    buckets.doc_topics.pop_back();
+}
+
+static inline void insert_doc_topic(sparse_buckets & buckets, const std::size_t t) {
+    buckets.doc_pos[t] = buckets.doc_topics.size();
+    buckets.doc_topics.push_back(t);
+}
+
+void sparse_gibbs(
+    sparse_count_matrix_t const& dwcm,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens, count_vector_t & ztot,
+    sparse_buckets & buckets,
+    counter_rng & rng,
+    const std::size_t n_topics, const double N, const double alpha, const double beta,
+    dirty_words * dirty) {
+
+    const std::size_t n_docs = dwcm.rows();
+    const double wbeta = N * beta;
+    const double abeta = alpha * beta;
+
+    std::vector<double> & coef = buckets.coef;
+    std::vector<double> & qmass = buckets.qmass;
+    std::vector<std::size_t> & doc_topics = buckets.doc_topics;
+
+    coef.resize(n_topics);
+    qmass.resize(n_topics);
+    buckets.doc_pos.resize(n_topics);
+
+    if(!buckets.index_valid) {
+        build_word_topics(buckets, dwcm, twcm);
+    }
+
+    std::size_t pos = 0;
+
+    for(std::size_t d = 0; d < n_docs; ++d) {
+        // the smoothing and document buckets are recomputed for each
+        // document so rounding error from the incremental updates can't
+        // accumulate across the sweep
+        //
+        double s = 0.0;
+        double r = 0.0;
+        doc_topics.clear();
+
+        for(std::size_t t = 0; t < n_topics; ++t) {
+            const double den = ztot[t] + wbeta;
+            const double ndt = tdcm(t, d);
+            s += abeta / den;
+            if(ndt > 0) {
+                insert_doc_topic(buckets, t);
+                r += (ndt * beta) / den;
+            }
+            coef[t] = (alpha + ndt) / den;
+        }
+
+        rng.prefetch(pos, doc_tokens(dwcm, d));
+
+        const auto dwcm_end = dwcm.end(d);
+        for(sparse_count_matrix_t::ConstIterator it = dwcm.begin(d); it != dwcm_end; ++it) {
+            const std::size_t w = it->index();
+            const std::size_t k_max = static_cast<std::size_t>(it->value());
+            std::vector<std::size_t> & word_topics = buckets.word_topics[w];
+
+            for(std::size_t k = 0; k < k_max; k++) {
+                // remove the token's current assignment from the buckets
+                //
+                const std::size_t t = tokens.get(pos);
+                rng.seek(pos);
+                {
+                    const double den = ztot[t] + wbeta;
+                    s -= abeta / den;
+                    r -= (tdcm(t, d) * beta) / den;
+                }
+
+                ztot[t] -= 1;
+                twcm(t, w) -= 1;
+                tdcm(t, d) -= 1;
+
+                {
+                    const double den = ztot[t] + wbeta;
+                    const double ndt = tdcm(t, d);
+                    s += abeta / den;
+                    r += (ndt * beta) / den;
+                    coef[t] = (alpha + ndt) / den;
+
+                    if(ndt <= 0) {
+                        remove_doc_topic(buckets, t);
+                    }
+                    if(twcm(t, w) <= 0) {
+                        remove_word_topic(word_topics, t);
+                    }
+                }
+
+                // topic-word bucket
+                //
+                const std::size_t n_wt = word_topics.size();
+                double q = 0.0;
+                for(std::size_t j = 0; j < n_wt; ++j) {
+                    const std::size_t wt = word_topics[j];
+                    qmass[j] = coef[wt] * twcm(wt, w);
+                    q += qmass[j];
+                }
+
+                double u = (s + r + q) * rng();
+                std::size_t nt = 0;
+
+                if(u < q) {
+                    std::size_t j = 0;
+                    double curprob = qmass[j];
+                    while(curprob < u && (j+1) < n_wt) {
+                        ++j;
+                        curprob += qmass[j];
+                    }
+                    nt = word_topics[j];
+                }
+                else if((u -= q) < r && doc_topics.size() > 0) {
+                    const std::size_t n_dt = doc_topics.size();
+                    std::size_t j = 0;
+                    double curprob = (tdcm(doc_topics[j], d) * beta) / (ztot[doc_topics[j]] + wbeta);
+                    while(curprob < u && (j+1) < n_dt) {
+                        ++j;
+                        curprob += (tdcm(doc_topics[j], d) * beta) / (ztot[doc_topics[j]] + wbeta);
+                    }
+                    nt = doc_topics[j];
+                }
+                else {
+                    u -= r;
+                    double curprob = abeta / (ztot[nt] + wbeta);
+                    while(curprob < u && (nt+1) < n_topics) {
+                        ++nt;
+                        curprob += abeta / (ztot[nt] + wbeta);
+                    }
+                }
+
+                // add the new assignment back into the buckets
+                //
+                {
+                    const double den = ztot[nt] + wbeta;
+                    s -= abeta / den;
+                    r -= (tdcm(nt, d) * beta) / den;
+
+                    if(tdcm(nt, d) <= 0) {
+                        insert_doc_topic(buckets, nt);
+                    }
+                    if(twcm(nt, w) <= 0) {
+                        insert_word_topic(word_topics, nt);
+                    }
+                }
+
+                if(dirty != nullptr && nt != t) {
+                    dirty->mark(w);
+                }
+
+                tokens.set(pos, nt);
+                ztot[nt] += 1;
+                twcm(nt, w) += 1;
+                tdcm(nt, d) += 1;
+
+                {
+                    const double den = ztot[nt] + wbeta;
+                    const double ndt = tdcm(nt, d);
+                    s += abeta / den;
+                    r += (ndt * beta) / den;
+                    coef[nt] = (alpha + ndt) / den;
+                }
+
+                ++pos;
+            }
+        }
+    }
+}
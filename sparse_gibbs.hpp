@@ -0,0 +1,88 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __SPARSE_GIBBS_HPP__
+#define __SPARSE_GIBBS_HPP__
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+#include <blaze/Math.h>
+
+#include "gibbs.hpp"
+#include "counter_rng.hpp"
+#include "token_topics.hpp"
+#include "counts.hpp"
+
+using blaze::DynamicMatrix;
+using blaze::DynamicVector;
+using blaze::CompressedMatrix;
+
+// SparseLDA (Yao, Mimno, McCallum 2009) splits the sampling
+// distribution of a token into three buckets
+//
+//   s = sum_t alpha * beta / (ztot[t] + wbeta)                 smoothing
+//   r = sum_t tdcm(t,d) * beta / (ztot[t] + wbeta)            document
+//   q = sum_t (alpha + tdcm(t,d)) * twcm(t,w) / (ztot[t] + wbeta)  topic-word
+//
+// r only has terms for topics present in the document and q only has
+// terms for topics present in the word; s and r are updated incrementally
+// as counts change, q is rebuilt per token from a cached coefficient.
+//
+// sparse_buckets holds the scratch state and is reused between sweeps
+// the same way `probs` is reused by gibbs()
+//
+// q walks an index of the topics present in each of the shard's distinct
+// words. the index is built from twcm on the first sweep and kept up to
+// date as the shard's tokens move; trainers that overwrite replica
+// columns after a reduction pass those columns to refresh_word_topics,
+// and trainers that move documents between shards call
+// reset_word_topics. twcm must only change through this thread's sweep
+// (a replica): other threads' adds would leave the index stale, and
+// rescanning the word's column for every token makes q O(K), so the
+// trainers sampling a shared twcm reject the sparse sampler
+//
+struct sparse_buckets {
+    // (alpha + tdcm(t,d)) / (ztot[t] + wbeta) for the current document
+    std::vector<double> coef;
+    // per-topic mass of the topic-word bucket for the current token
+    std::vector<double> qmass;
+    // topics with a non-zero count for each word of the shard
+    std::vector< std::vector<std::size_t> > word_topics;
+    // the shard's distinct words, and which words word_topics covers
+    std::vector<std::size_t> index_words;
+    std::vector<std::uint8_t> indexed;
+    bool index_valid;
+    // topics with a non-zero count in the current document
+    std::vector<std::size_t> doc_topics;
+    // position of each topic in doc_topics
+    std::vector<std::size_t> doc_pos;
+
+    sparse_buckets() : coef(), qmass(), word_topics(), index_words(), indexed(), index_valid(false), doc_topics(), doc_pos() {}
+};
+
+// the index is rebuilt from twcm on the next sweep
+//
+void reset_word_topics(sparse_buckets & buckets);
+
+// re-reads the index entries of words whose twcm columns the caller
+// overwrote; words outside the shard are skipped
+//
+void refresh_word_topics(sparse_buckets & buckets, count_matrix_t const& twcm, std::vector<std::size_t> const& words);
+
+void sparse_gibbs(
+    sparse_count_matrix_t const& dwcm,
+    count_matrix_t & tdcm,
+    count_matrix_t & twcm,
+    token_topics & tokens, count_vector_t & ztot,
+    sparse_buckets & buckets,
+    counter_rng & rng,
+    const std::size_t n_topics, const double N, const double alpha, const double beta,
+    dirty_words * dirty = nullptr);
+
+#endif
@@ -0,0 +1,247 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "topic_draw.hpp"
+
+#include <cstdint>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define __TOPIC_DRAW_X86__ 1
+#include <immintrin.h>
+#endif
+
+// first index in [lo, hi) with cdf[idx] >= thresh; cdf is nondecreasing so
+// bisect down to a few vector widths and let the caller scan what is left
+//
+static inline void bisect_cdf(const double * cdf, const double thresh, const std::size_t width, std::size_t & lo, std::size_t & hi) {
+    while((hi - lo) > (4 * width)) {
+        const std::size_t mid = lo + ((hi - lo) / 2);
+        if(cdf[mid] < thresh) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid + 1;
+        }
+    }
+}
+
+// rounding can leave thresh above every entry; fall back to the last topic
+// rather than walking past the end of cdf
+//
+static inline std::size_t scan_cdf(const double * cdf, const double thresh, std::size_t lo, const std::size_t hi, const std::size_t n_topics) {
+    for(; lo < hi; ++lo) {
+        if(cdf[lo] >= thresh) {
+            return lo;
+        }
+    }
+
+    return n_topics - 1;
+}
+
+// K > 0 fixes the number of topics at compile time, K == 0 reads it from
+// the runtime argument
+//
+template<std::size_t K>
+static std::size_t draw_topic_scalar(
+    const count_t * twcm_w, const count_t * tdcm_d, const double * rztot,
+    double * cdf, const double u,
+    const std::size_t runtime_topics, const double alpha, const double beta) {
+
+    const std::size_t n_topics = (K > 0) ? K : runtime_topics;
+
+    double totprob = 0.0;
+    for(std::size_t i = 0; i < n_topics; ++i) {
+        totprob += ((twcm_w[i] + beta) * (tdcm_d[i] + alpha)) * rztot[i];
+        cdf[i] = totprob;
+    }
+
+    const double thresh = totprob * u;
+    std::size_t lo = 0, hi = n_topics;
+    bisect_cdf(cdf, thresh, 1, lo, hi);
+    return scan_cdf(cdf, thresh, lo, hi, n_topics);
+}
+
+#ifdef __TOPIC_DRAW_X86__
+
+template<std::size_t K>
+__attribute__((target("avx2")))
+static std::size_t draw_topic_avx2(
+    const count_t * twcm_w, const count_t * tdcm_d, const double * rztot,
+    double * cdf, const double u,
+    const std::size_t runtime_topics, const double alpha, const double beta) {
+
+    const std::size_t n_topics = (K > 0) ? K : runtime_topics;
+
+    const __m256d valpha = _mm256_set1_pd(alpha);
+    const __m256d vbeta = _mm256_set1_pd(beta);
+    const __m256d zero = _mm256_setzero_pd();
+
+    // carry holds the running total broadcast to every lane
+    //
+    __m256d carry = zero;
+    std::size_t i = 0;
+
+    for(; (i + 4) <= n_topics; i += 4) {
+        const __m256d tw = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(twcm_w + i)));
+        const __m256d td = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(tdcm_d + i)));
+        __m256d p = _mm256_mul_pd(_mm256_mul_pd(_mm256_add_pd(tw, vbeta), _mm256_add_pd(td, valpha)), _mm256_loadu_pd(rztot + i));
+
+        // inclusive prefix sum of the 4 lanes: shift by 1 then by 2
+        //
+        p = _mm256_add_pd(p, _mm256_blend_pd(_mm256_permute4x64_pd(p, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x1));
+        p = _mm256_add_pd(p, _mm256_blend_pd(_mm256_permute4x64_pd(p, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x3));
+        p = _mm256_add_pd(p, carry);
+
+        _mm256_storeu_pd(cdf + i, p);
+        carry = _mm256_permute4x64_pd(p, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    // remainder topics; a fixed K that is a multiple of the vector width
+    // has none
+    //
+    double totprob = _mm256_cvtsd_f64(carry);
+    if((K == 0) || ((K % 4) != 0)) {
+        for(; i < n_topics; ++i) {
+            totprob += ((twcm_w[i] + beta) * (tdcm_d[i] + alpha)) * rztot[i];
+            cdf[i] = totprob;
+        }
+    }
+
+    const double thresh = totprob * u;
+    std::size_t lo = 0, hi = n_topics;
+    bisect_cdf(cdf, thresh, 4, lo, hi);
+
+    const __m256d vthresh = _mm256_set1_pd(thresh);
+    for(; (lo + 4) <= hi; lo += 4) {
+        const int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(cdf + lo), vthresh, _CMP_GE_OQ));
+        if(mask != 0) {
+            return lo + static_cast<std::size_t>(__builtin_ctz(mask));
+        }
+    }
+
+    return scan_cdf(cdf, thresh, lo, hi, n_topics);
+}
+
+template<std::size_t K>
+__attribute__((target("avx512f")))
+static std::size_t draw_topic_avx512(
+    const count_t * twcm_w, const count_t * tdcm_d, const double * rztot,
+    double * cdf, const double u,
+    const std::size_t runtime_topics, const double alpha, const double beta) {
+
+    const std::size_t n_topics = (K > 0) ? K : runtime_topics;
+
+    const __m512d valpha = _mm512_set1_pd(alpha);
+    const __m512d vbeta = _mm512_set1_pd(beta);
+
+    // lane permutations shifting the vector up by 1, 2 and 4 lanes; the
+    // vacated low lanes are zeroed by the masks. full-mask maskz forms are
+    // used elsewhere because gcc warns about the undefined passthrough
+    // operand of the unmasked intrinsics
+    //
+    const __m512i shift1 = _mm512_set_epi64(6, 5, 4, 3, 2, 1, 0, 0);
+    const __m512i shift2 = _mm512_set_epi64(5, 4, 3, 2, 1, 0, 0, 0);
+    const __m512i shift4 = _mm512_set_epi64(3, 2, 1, 0, 0, 0, 0, 0);
+    const __m512i last = _mm512_set1_epi64(7);
+
+    __m512d carry = _mm512_setzero_pd();
+    std::size_t i = 0;
+
+    for(; (i + 8) <= n_topics; i += 8) {
+        const __m512d tw = _mm512_maskz_cvtepi32_pd(0xFF, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(twcm_w + i)));
+        const __m512d td = _mm512_maskz_cvtepi32_pd(0xFF, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tdcm_d + i)));
+        __m512d p = _mm512_mul_pd(_mm512_mul_pd(_mm512_add_pd(tw, vbeta), _mm512_add_pd(td, valpha)), _mm512_loadu_pd(rztot + i));
+
+        p = _mm512_add_pd(p, _mm512_maskz_permutexvar_pd(0xFE, shift1, p));
+        p = _mm512_add_pd(p, _mm512_maskz_permutexvar_pd(0xFC, shift2, p));
+        p = _mm512_add_pd(p, _mm512_maskz_permutexvar_pd(0xF0, shift4, p));
+        p = _mm512_add_pd(p, carry);
+
+        _mm512_storeu_pd(cdf + i, p);
+        carry = _mm512_maskz_permutexvar_pd(0xFF, last, p);
+    }
+
+    // remainder topics; a fixed K that is a multiple of the vector width
+    // has none
+    //
+    double totprob = _mm512_cvtsd_f64(carry);
+    if((K == 0) || ((K % 8) != 0)) {
+        for(; i < n_topics; ++i) {
+            totprob += ((twcm_w[i] + beta) * (tdcm_d[i] + alpha)) * rztot[i];
+            cdf[i] = totprob;
+        }
+    }
+
+    const double thresh = totprob * u;
+    std::size_t lo = 0, hi = n_topics;
+    bisect_cdf(cdf, thresh, 8, lo, hi);
+
+    const __m512d vthresh = _mm512_set1_pd(thresh);
+    for(; (lo + 8) <= hi; lo += 8) {
+        const __mmask8 mask = _mm512_cmp_pd_mask(_mm512_loadu_pd(cdf + lo), vthresh, _CMP_GE_OQ);
+        if(mask != 0) {
+            return lo + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned int>(mask)));
+        }
+    }
+
+    return scan_cdf(cdf, thresh, lo, hi, n_topics);
+}
+
+#endif
+
+draw_kernel best_draw_kernel() {
+#ifdef __TOPIC_DRAW_X86__
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) {
+        return draw_kernel::avx512;
+    }
+    if(__builtin_cpu_supports("avx2")) {
+        return draw_kernel::avx2;
+    }
+#endif
+    return draw_kernel::scalar;
+}
+
+template<std::size_t K>
+static draw_topic_fn select_draw_kernel(const draw_kernel kernel) {
+    switch(kernel) {
+#ifdef __TOPIC_DRAW_X86__
+        case draw_kernel::avx512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f") ? draw_topic_avx512<K> : nullptr;
+        case draw_kernel::avx2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") ? draw_topic_avx2<K> : nullptr;
+#endif
+        case draw_kernel::scalar:
+            return draw_topic_scalar<K>;
+        default:
+            return nullptr;
+    }
+}
+
+draw_topic_fn draw_topic_kernel(const draw_kernel kernel) {
+    return select_draw_kernel<0>(kernel);
+}
+
+draw_topic_fn draw_topic_kernel(const draw_kernel kernel, const std::size_t n_topics) {
+    draw_topic_fn draw = nullptr;
+    with_fixed_topics(n_topics, [&draw, kernel](auto K) {
+        draw = select_draw_kernel<decltype(K)::value>(kernel);
+    });
+    return draw;
+}
+
+const char * draw_kernel_name(const draw_kernel kernel) {
+    switch(kernel) {
+        case draw_kernel::avx512:
+            return "avx512";
+        case draw_kernel::avx2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
@@ -0,0 +1,77 @@
+//  Copyright (c) 2021 Christopher Taylor
+//
+//  SPDX-License-Identifier: BSL-1.0
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+#ifndef __TOPIC_DRAW_HPP__
+#define __TOPIC_DRAW_HPP__
+
+#include <cstdint>
+#include <type_traits>
+
+#include "counts.hpp"
+
+// topic draw kernel of the dense sampler
+//
+// computes p[t] = (twcm_w[t] + beta) * (tdcm_d[t] + alpha) * rztot[t] as a
+// running prefix sum into cdf[0, n_topics) and returns the first topic
+// whose cumulative mass reaches u * cdf[n_topics-1]; u is in [0, 1)
+//
+// rztot[t] = 1.0 / (ztot[t] + wbeta) is maintained by the caller, which
+// only has to refresh the two topics a token moved between instead of
+// dividing by (ztot + wbeta) for every topic of every token
+//
+// scalar - portable loop
+// avx2   - 4 topics per step
+// avx512 - 8 topics per step (avx512f)
+//
+enum class draw_kernel { scalar, avx2, avx512 };
+
+using draw_topic_fn = std::size_t (*)(
+    const count_t * twcm_w, const count_t * tdcm_d, const double * rztot,
+    double * cdf, const double u,
+    const std::size_t n_topics, const double alpha, const double beta);
+
+// topic counts with kernels specialized at compile time; their loops are
+// fully unrolled and the dense sampler keeps its cdf buffer on the stack.
+// other topic counts use the generic kernels
+//
+template<std::size_t... Ks>
+struct topic_counts {};
+
+using fixed_topic_counts = topic_counts<16, 32, 64, 100, 128, 256, 512, 1024>;
+
+// calls f(std::integral_constant<std::size_t, K>) with K == n_topics when
+// n_topics is one of fixed_topic_counts, and with K == 0 otherwise
+//
+template<typename F, std::size_t... Ks>
+inline void with_fixed_topics(topic_counts<Ks...>, const std::size_t n_topics, F && f) {
+    const bool fixed = ( ((n_topics == Ks) ? (f(std::integral_constant<std::size_t, Ks>{}), true) : false) || ... );
+    if(!fixed) {
+        f(std::integral_constant<std::size_t, 0>{});
+    }
+}
+
+template<typename F>
+inline void with_fixed_topics(const std::size_t n_topics, F && f) {
+    with_fixed_topics(fixed_topic_counts{}, n_topics, f);
+}
+
+// widest kernel the running cpu supports
+//
+draw_kernel best_draw_kernel();
+
+// nullptr when the kernel is not supported by the compiler or cpu
+//
+draw_topic_fn draw_topic_kernel(const draw_kernel kernel);
+
+// as above, specialized for n_topics when it is one of fixed_topic_counts;
+// the returned kernel must only be called with that n_topics
+//
+draw_topic_fn draw_topic_kernel(const draw_kernel kernel, const std::size_t n_topics);
+
+const char * draw_kernel_name(const draw_kernel kernel);
+
+#endif